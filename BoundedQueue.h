@@ -0,0 +1,84 @@
+#ifndef FACELIB_BOUNDEDQUEUE_H
+#define FACELIB_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Internal blocking queue with a fixed capacity, used to connect pipeline stages - not part of the public header.
+// push() blocks while the queue is full; pop() blocks while it is empty and returns false once the queue
+// has been closed and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Returns false if the queue was closed before the item could be added.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Moves up to maxItems items into batch, replacing its contents. Blocks and returns false like pop().
+    bool popBatch(std::vector<T>& batch, size_t maxItems) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        batch.clear();
+        while (!items.empty() && batch.size() < maxItems) {
+            batch.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        lock.unlock();
+        notFull.notify_all();
+        return true;
+    }
+
+    // No further pushes are accepted; consumers drain what is left and then see pop() return false.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif //FACELIB_BOUNDEDQUEUE_H
@@ -0,0 +1,233 @@
+#include "BufferPool.h"
+#include "FaceLib.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr int MinClassBits = 16;   // 64 KiB: smaller buffers go straight to the system allocator.
+constexpr int MaxClassBits = 28;   // 256 MiB: larger buffers are never cached.
+constexpr int StepsPerPowerOfTwo = 4;
+constexpr int ClassCount = (MaxClassBits - MinClassBits) * StepsPerPowerOfTwo;
+constexpr size_t ThreadCacheBlocksPerClass = 4;
+
+thread_local bool threadCacheDestroyed = false;
+
+struct SizeClass {
+    int index;     // -1 when the size is not pooled
+    size_t bytes;  // bytes actually allocated for the class
+};
+
+// Sizes in (2^k, 2^(k+1)] are rounded up to a multiple of 2^(k-2), giving classes of 5/4, 6/4, 7/4 and 8/4 * 2^k.
+SizeClass classify(size_t size) {
+    if (size <= (size_t(1) << MinClassBits) || size > (size_t(1) << MaxClassBits)) {
+        return {-1, size};
+    }
+    int k = 0;
+    while ((size_t(1) << (k + 1)) < size) {
+        ++k;
+    }
+    size_t step = size_t(1) << (k - 2);
+    size_t steps = (size + step - 1) / step; // 5..8
+    return {(k - MinClassBits) * StepsPerPowerOfTwo + static_cast<int>(steps - 5), steps * step};
+}
+
+class BufferPool {
+public:
+    void* acquire(size_t size) {
+        SizeClass sizeClass = classify(size);
+        if (sizeClass.index < 0) {
+            return cv::fastMalloc(size);
+        }
+
+        ThreadCache* cache = localCache();
+        if (void* block = cache ? cache->pop(sizeClass.index) : nullptr) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            cachedBytes.fetch_sub(sizeClass.bytes, std::memory_order_relaxed);
+            return block;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sharedMutex);
+            auto& blocks = shared[sizeClass.index];
+            if (!blocks.empty()) {
+                void* block = blocks.back();
+                blocks.pop_back();
+                hits.fetch_add(1, std::memory_order_relaxed);
+                cachedBytes.fetch_sub(sizeClass.bytes, std::memory_order_relaxed);
+                return block;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return cv::fastMalloc(sizeClass.bytes);
+    }
+
+    void release(void* block, size_t size) {
+        SizeClass sizeClass = classify(size);
+        if (sizeClass.index < 0) {
+            cv::fastFree(block);
+            return;
+        }
+        if (cachedBytes.load(std::memory_order_relaxed) + sizeClass.bytes > limit.load(std::memory_order_relaxed)) {
+            cv::fastFree(block);
+            return;
+        }
+
+        cachedBytes.fetch_add(sizeClass.bytes, std::memory_order_relaxed);
+        ThreadCache* cache = localCache();
+        if (cache && cache->push(sizeClass.index, block)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        shared[sizeClass.index].push_back(block);
+    }
+
+    // Frees every buffer in the shared pool; per-thread caches hand theirs back as their threads exit.
+    void trim() {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        for (int index = 0; index < ClassCount; ++index) {
+            for (void* block : shared[index]) {
+                cachedBytes.fetch_sub(classBytes(index), std::memory_order_relaxed);
+                cv::fastFree(block);
+            }
+            shared[index].clear();
+        }
+    }
+
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+    std::atomic<size_t> cachedBytes{0};
+    std::atomic<size_t> limit{size_t(512) << 20};
+
+private:
+    static size_t classBytes(int index) {
+        int k = index / StepsPerPowerOfTwo + MinClassBits;
+        return (index % StepsPerPowerOfTwo + 5) * (size_t(1) << (k - 2));
+    }
+
+    struct ThreadCache {
+        std::array<std::array<void*, ThreadCacheBlocksPerClass>, ClassCount> blocks{};
+        std::array<size_t, ClassCount> counts{};
+        BufferPool* owner = nullptr;
+
+        void* pop(int index) {
+            return counts[index] > 0 ? blocks[index][--counts[index]] : nullptr;
+        }
+
+        bool push(int index, void* block) {
+            if (counts[index] == ThreadCacheBlocksPerClass) {
+                return false;
+            }
+            blocks[index][counts[index]++] = block;
+            return true;
+        }
+
+        // Buffers cached by an exiting thread move to the shared pool for the threads that remain.
+        ~ThreadCache() {
+            threadCacheDestroyed = true;
+            if (!owner) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(owner->sharedMutex);
+            for (int index = 0; index < ClassCount; ++index) {
+                for (size_t i = 0; i < counts[index]; ++i) {
+                    owner->shared[index].push_back(blocks[index][i]);
+                }
+            }
+        }
+    };
+
+    // Null once the thread's cache has been destroyed, e.g. for Mats released by later thread_local destructors.
+    ThreadCache* localCache() {
+        if (threadCacheDestroyed) {
+            return nullptr;
+        }
+        thread_local ThreadCache cache;
+        cache.owner = this;
+        return &cache;
+    }
+
+    std::mutex sharedMutex;
+    std::array<std::vector<void*>, ClassCount> shared;
+};
+
+// Leaked on purpose: pooled Mats may be released after static destructors have run.
+BufferPool& pool() {
+    static BufferPool* instance = new BufferPool();
+    return *instance;
+}
+
+} // namespace
+
+cv::UMatData* PooledMatAllocator::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                           cv::AccessFlag, cv::UMatUsageFlags) const {
+    // Same layout rules as OpenCV's standard allocator.
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != cv::Mat::AUTO_STEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    uchar* data = data0 ? static_cast<uchar*>(data0) : static_cast<uchar*>(pool().acquire(total));
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+    return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData* data, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return data != nullptr;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        pool().release(u->origdata, u->size);
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+cv::MatAllocator* getPooledMatAllocator() {
+    static PooledMatAllocator* allocator = new PooledMatAllocator();
+    return allocator;
+}
+
+FACELIB_API BufferPoolStats getBufferPoolStats() {
+    BufferPoolStats stats;
+    stats.hits = pool().hits.load(std::memory_order_relaxed);
+    stats.misses = pool().misses.load(std::memory_order_relaxed);
+    stats.cachedBytes = pool().cachedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+FACELIB_API void resetBufferPoolStats() {
+    pool().hits.store(0, std::memory_order_relaxed);
+    pool().misses.store(0, std::memory_order_relaxed);
+}
+
+FACELIB_API void setBufferPoolLimit(size_t maxCachedBytes) {
+    pool().limit.store(maxCachedBytes, std::memory_order_relaxed);
+    if (pool().cachedBytes.load(std::memory_order_relaxed) > maxCachedBytes) {
+        pool().trim();
+    }
+}
+
+FACELIB_API void trimBufferPool() {
+    pool().trim();
+}
@@ -0,0 +1,23 @@
+#ifndef FACELIB_BUFFERPOOL_H
+#define FACELIB_BUFFERPOOL_H
+
+#include <opencv2/core.hpp>
+
+// Internal cv::MatAllocator that recycles pixel buffers - not part of the public header.
+// Buffers are grouped into size classes (four per power of two, so at most 25% slack). A released
+// buffer goes to a small per-thread cache first and then to a shared pool; an allocation is served
+// from the same places before falling back to cv::fastMalloc. Buffers below the smallest class are
+// not worth pooling and go straight to cv::fastMalloc.
+class PooledMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+};
+
+// Process-wide allocator for ImageData pixel storage. Never destroyed, so Mats released during
+// static destruction or from exiting threads stay valid.
+cv::MatAllocator* getPooledMatAllocator();
+
+#endif //FACELIB_BUFFERPOOL_H
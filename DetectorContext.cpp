@@ -0,0 +1,371 @@
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstdlib>
+
+// Persistent detection state for a stream of same-sized frames. Creating a context plans the pyramid
+// for its frame size and allocates every level, resize table and row buffer up front; the integral
+// images, hit lists and grouping buffers grow during the first frames and are then reused. Conversion,
+// resizing and grouping are done here rather than by OpenCV, whose functions allocate temporary
+// buffers on every call, and native cascades scan on the calling thread.
+
+namespace {
+
+// Bilinear resize tables for one axis: the two source taps of each target pixel and the weight of the
+// second tap, out of 256. Pixel centres line up as in cv::INTER_LINEAR_EXACT.
+struct ResizeAxis {
+    std::vector<int> first;
+    std::vector<int> second;
+    std::vector<int> weight;
+
+    ResizeAxis(int source, int target) : first(target), second(target), weight(target) {
+        double scale = static_cast<double>(source) / target;
+        for (int i = 0; i < target; ++i) {
+            double position = (i + 0.5) * scale - 0.5;
+            int index = cvFloor(position);
+            double fraction = position - index;
+            if (index < 0) {
+                index = 0;
+                fraction = 0;
+            }
+            if (index >= source - 1) {
+                index = source - 1;
+                fraction = 0;
+            }
+            first[i] = index;
+            second[i] = std::min(index + 1, source - 1);
+            weight[i] = cvRound(fraction * 256);
+        }
+    }
+};
+
+struct LevelImage {
+    cv::Mat image;  // empty for the full-size level, which is the grayscale frame itself
+    ResizeAxis columns;
+    ResizeAxis rows;
+};
+
+struct LevelScan {
+    size_t cascade;
+    size_t image;
+    float factor;
+};
+
+// Buffers of groupHits().
+struct GroupScratch {
+    std::vector<int> parent;
+    std::vector<int> rank;
+    std::vector<int> labels;
+    std::vector<int> counts;
+    std::vector<cv::Rect> classes;
+};
+
+// cv::groupRectangles(rects, threshold, eps) on reusable buffers: the same union-find partition, class
+// averages and nested-face filter, in the same order, so the faces come out identical.
+void groupHits(std::vector<cv::Rect>& rects, int threshold, double eps, GroupScratch& scratch) {
+    if (threshold <= 0 || rects.empty()) {
+        return;
+    }
+
+    int count = static_cast<int>(rects.size());
+    std::vector<int>& parent = scratch.parent;
+    std::vector<int>& rank = scratch.rank;
+    parent.assign(count, -1);
+    rank.assign(count, 0);
+    auto similar = [eps](const cv::Rect& a, const cv::Rect& b) {
+        double delta = eps * (std::min(a.width, b.width) + std::min(a.height, b.height)) * 0.5;
+        return std::abs(a.x - b.x) <= delta && std::abs(a.y - b.y) <= delta &&
+               std::abs(a.x + a.width - b.x - b.width) <= delta && std::abs(a.y + a.height - b.y - b.height) <= delta;
+    };
+    for (int i = 0; i < count; ++i) {
+        int root = i;
+        while (parent[root] >= 0) {
+            root = parent[root];
+        }
+        for (int j = 0; j < count; ++j) {
+            if (i == j || !similar(rects[i], rects[j])) {
+                continue;
+            }
+            int otherRoot = j;
+            while (parent[otherRoot] >= 0) {
+                otherRoot = parent[otherRoot];
+            }
+            if (otherRoot == root) {
+                continue;
+            }
+            if (rank[root] > rank[otherRoot]) {
+                parent[otherRoot] = root;
+            } else {
+                parent[root] = otherRoot;
+                rank[otherRoot] += rank[root] == rank[otherRoot];
+                root = otherRoot;
+            }
+            for (int k : {j, i}) {
+                for (int next; (next = parent[k]) >= 0; k = next) {
+                    parent[k] = root;
+                }
+            }
+        }
+    }
+
+    // Class labels in order of first appearance; the rank slot of each root is reused for its label.
+    int classCount = 0;
+    scratch.labels.resize(count);
+    for (int i = 0; i < count; ++i) {
+        int root = i;
+        while (parent[root] >= 0) {
+            root = parent[root];
+        }
+        if (rank[root] >= 0) {
+            rank[root] = ~classCount++;
+        }
+        scratch.labels[i] = ~rank[root];
+    }
+
+    std::vector<cv::Rect>& classes = scratch.classes;
+    std::vector<int>& counts = scratch.counts;
+    classes.assign(classCount, cv::Rect());
+    counts.assign(classCount, 0);
+    for (int i = 0; i < count; ++i) {
+        cv::Rect& sum = classes[scratch.labels[i]];
+        sum.x += rects[i].x;
+        sum.y += rects[i].y;
+        sum.width += rects[i].width;
+        sum.height += rects[i].height;
+        ++counts[scratch.labels[i]];
+    }
+    for (int c = 0; c < classCount; ++c) {
+        float scale = 1.f / counts[c];
+        cv::Rect& r = classes[c];
+        r = cv::Rect(cvRound(r.x * scale), cvRound(r.y * scale), cvRound(r.width * scale), cvRound(r.height * scale));
+    }
+
+    rects.clear();
+    for (int i = 0; i < classCount; ++i) {
+        const cv::Rect& r1 = classes[i];
+        int n1 = counts[i];
+        if (n1 <= threshold) {
+            continue;
+        }
+        // Drop faces inside a better-supported face.
+        int j = 0;
+        for (; j < classCount; ++j) {
+            int n2 = counts[j];
+            if (j == i || n2 <= threshold) {
+                continue;
+            }
+            const cv::Rect& r2 = classes[j];
+            int dx = cvRound(r2.width * eps);
+            int dy = cvRound(r2.height * eps);
+            if (r1.x >= r2.x - dx && r1.y >= r2.y - dy && r1.x + r1.width <= r2.x + r2.width + dx &&
+                r1.y + r1.height <= r2.y + r2.height + dy && (n2 > std::max(3, n1) || n1 < 3)) {
+                break;
+            }
+        }
+        if (j == classCount) {
+            rects.push_back(r1);
+        }
+    }
+}
+
+// cv::COLOR_BGR2GRAY's fixed-point weights.
+void convertToGray(const cv::Mat& frame, cv::Mat& gray) {
+    const int blue = 1868, green = 9617, red = 4899, shift = 14;
+    int channels = frame.channels();
+    for (int y = 0; y < frame.rows; ++y) {
+        const unsigned char* in = frame.ptr<unsigned char>(y);
+        unsigned char* out = gray.ptr<unsigned char>(y);
+        for (int x = 0; x < frame.cols; ++x, in += channels) {
+            out[x] = static_cast<unsigned char>((in[0] * blue + in[1] * green + in[2] * red + (1 << (shift - 1))) >> shift);
+        }
+    }
+}
+
+void resizeLevel(const cv::Mat& source, LevelImage& level, std::vector<int>& rowBuffer) {
+    cv::Mat& target = level.image;
+    int* upper = rowBuffer.data();
+    int* lower = upper + target.cols;
+    auto horizontal = [&](const unsigned char* in, int* out) {
+        for (int x = 0; x < target.cols; ++x) {
+            int weight = level.columns.weight[x];
+            out[x] = in[level.columns.first[x]] * (256 - weight) + in[level.columns.second[x]] * weight;
+        }
+    };
+    for (int y = 0; y < target.rows; ++y) {
+        horizontal(source.ptr<unsigned char>(level.rows.first[y]), upper);
+        horizontal(source.ptr<unsigned char>(level.rows.second[y]), lower);
+        int weight = level.rows.weight[y];
+        unsigned char* out = target.ptr<unsigned char>(y);
+        for (int x = 0; x < target.cols; ++x) {
+            out[x] = static_cast<unsigned char>((upper[x] * (256 - weight) + lower[x] * weight + (1 << 15)) >> 16);
+        }
+    }
+}
+
+} // namespace
+
+class DetectorContext {
+public:
+    DetectorContext(const FaceDetector& detector, cv::Size frameSize, const DetectOptions& options)
+        : classifiers(detector), frameSize(frameSize), options(options), hits(detector.cascadeCount()) {
+        if (detector.waldBoostModel()) {
+            throw FaceDetectionException("Detector contexts need a cascade detector");
+        }
+        scratch.parallel = false;
+
+        // The levels detectMultiScale would scan for each cascade, shared between cascades by size.
+        for (size_t c = 0; c < detector.cascadeCount(); ++c) {
+            cv::Size window = detector.cascadeWindow(c);
+            std::vector<LevelScan> cascadeScans;
+            for (double factor = 1; ; factor *= options.scaleFactor) {
+                cv::Size windowSize(cvRound(window.width * factor), cvRound(window.height * factor));
+                if (windowSize.width > frameSize.width || windowSize.height > frameSize.height ||
+                    (options.maxSize > 0 && (windowSize.width > options.maxSize || windowSize.height > options.maxSize))) {
+                    break;
+                }
+                if (windowSize.width < options.minSize || windowSize.height < options.minSize) {
+                    continue;
+                }
+                float scale = static_cast<float>(factor);
+                cv::Size levelSize(cvRound(frameSize.width / scale), cvRound(frameSize.height / scale));
+                if (levelSize.width < window.width || levelSize.height < window.height) {
+                    break;
+                }
+                cascadeScans.push_back({c, levelImage(levelSize), scale});
+            }
+            size_t first = 0;
+            if (options.maxLevels > 0 && cascadeScans.size() > static_cast<size_t>(options.maxLevels)) {
+                first = cascadeScans.size() - options.maxLevels;  // keep the largest scales
+            }
+            scans.insert(scans.end(), cascadeScans.begin() + first, cascadeScans.end());
+        }
+
+        int widest = 0;
+        for (const auto& level : levels) {
+            widest = std::max(widest, level.image.cols);
+        }
+        rowBuffer.resize(2 * static_cast<size_t>(widest));
+    }
+
+    void detect(const cv::Mat& frame, std::vector<FaceRect>& faces) {
+        if (frame.size() != frameSize) {
+            throw ImageProcessingException("Frame size does not match the detector context");
+        }
+        if (frame.depth() != CV_8U || (frame.channels() != 1 && frame.channels() != 3 && frame.channels() != 4)) {
+            throw ImageProcessingException("Detector contexts take 8-bit grayscale, BGR or BGRA frames");
+        }
+        const cv::Mat* source = &frame;
+        if (frame.channels() != 1) {
+            gray.create(frameSize, CV_8UC1);  // allocated on the first colour frame only
+            convertToGray(frame, gray);
+            source = &gray;
+        }
+
+        for (auto& level : levels) {
+            if (!level.image.empty()) {
+                resizeLevel(*source, level, rowBuffer);
+            }
+        }
+        for (auto& cascadeHits : hits) {
+            cascadeHits.clear();
+        }
+        for (const LevelScan& scan : scans) {
+            const LevelImage& level = levels[scan.image];
+            const cv::Mat& image = level.image.empty() ? *source : level.image;
+            scanPyramidLevel(classifiers, scan.cascade, image, scan.factor, scratch, hits[scan.cascade]);
+        }
+
+        std::vector<cv::Rect>* found = &hits[0];
+        if (hits.size() == 1) {
+            groupHits(hits[0], options.minNeighbors, 0.2, grouping);
+        } else {
+            merged = mergeCascadeHits(classifiers.detector(), hits, options.minNeighbors);
+            found = &merged;
+        }
+
+        if (options.maxFaces > 0) {
+            // Insertion sort, largest first: stable like the other detection paths, without a temporary buffer.
+            std::vector<cv::Rect>& sorted = *found;
+            for (size_t i = 1; i < sorted.size(); ++i) {
+                cv::Rect face = sorted[i];
+                size_t j = i;
+                for (; j > 0 && sorted[j - 1].area() < face.area(); --j) {
+                    sorted[j] = sorted[j - 1];
+                }
+                sorted[j] = face;
+            }
+            if (sorted.size() > static_cast<size_t>(options.maxFaces)) {
+                sorted.resize(options.maxFaces);
+            }
+        }
+
+        faces.clear();
+        for (const auto& face : *found) {
+            faces.emplace_back(face.x, face.y, face.width, face.height);
+        }
+        FACELIB_TRACE("Context detected " << faces.size() << " face(s)");
+    }
+
+private:
+    size_t levelImage(cv::Size size) {
+        for (size_t i = 0; i < levels.size(); ++i) {
+            cv::Size existing = levels[i].image.empty() ? frameSize : levels[i].image.size();
+            if (existing == size) {
+                return i;
+            }
+        }
+        levels.push_back({size == frameSize ? cv::Mat() : cv::Mat(size, CV_8UC1),
+                          ResizeAxis(frameSize.width, size.width), ResizeAxis(frameSize.height, size.height)});
+        return levels.size() - 1;
+    }
+
+    FaceDetector::Lease classifiers;
+    cv::Size frameSize;
+    DetectOptions options;
+    cv::Mat gray;
+    std::vector<LevelImage> levels;
+    std::vector<LevelScan> scans;
+    std::vector<int> rowBuffer;
+    NativeScratch scratch;
+    std::vector<std::vector<cv::Rect>> hits;
+    std::vector<cv::Rect> merged;  // ensembles only
+    GroupScratch grouping;
+};
+
+FACELIB_API DetectorContextHandle createDetectorContext(const FaceDetector* detector, int width, int height, const DetectOptions& options) {
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    if (width <= 0 || height <= 0) {
+        throw ImageProcessingException("Detector context needs a positive frame size");
+    }
+    checkScaleFactor(options.scaleFactor);
+    try {
+        return DetectorContextHandle(new DetectorContext(*detector, cv::Size(width, height), options));
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error creating detector context: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API void deleteDetectorContext(DetectorContext* context) {
+    delete context;
+}
+
+void DetectorContextDeleter::operator()(DetectorContext* context) const {
+    deleteDetectorContext(context);
+}
+
+FACELIB_API void detectFaces(DetectorContext* context, const ImageData* image, std::vector<FaceRect>& faces) {
+    if (!context) {
+        throw FaceDetectionException("Detector context is null. Call createDetectorContext() first.");
+    }
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+    try {
+        context->detect(image->mat, faces);
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error during face detection: " + std::string(e.what()));
+    }
+}
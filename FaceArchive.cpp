@@ -0,0 +1,514 @@
+#include "FaceLib.h"
+#include "FaceLibLog.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+// Packed face archives. The data file is a header followed by one entry per crop: the source id and
+// then the encoded crop, with nothing in between. The index file is a header followed by one
+// fixed-size record per crop. Both are in native byte order, which the headers record.
+
+namespace {
+
+// "\r\n" in the magic catches files mangled by text-mode transfers.
+const char indexMagic[8] = {'F', 'L', 'F', 'I', 'D', 'X', '\r', '\n'};
+const char dataMagic[8] = {'F', 'L', 'F', 'D', 'A', 'T', '\r', '\n'};
+const uint32_t archiveVersion = 1;
+const uint32_t archiveByteOrder = 0x01020304;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t recordSize;
+    uint32_t reserved[3];
+};
+
+struct DataHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+};
+
+// One crop. check covers every other field, so a record whose write never completed - a hole of
+// zeros, or a torn write - is recognised as such.
+struct IndexRecord {
+    uint64_t offset;  // of the source id in the data file; the crop follows it
+    uint32_t sourceLength;
+    uint32_t dataLength;
+    int32_t x, y, width, height;
+    uint32_t reserved;
+    uint32_t check;
+};
+
+static_assert(sizeof(IndexHeader) == 32, "IndexHeader layout");
+static_assert(sizeof(DataHeader) == 16, "DataHeader layout");
+static_assert(sizeof(IndexRecord) == 40, "IndexRecord layout");
+
+std::string indexPath(const std::string& path) {
+    return path + ".index";
+}
+
+// FNV-1a over the record up to its check field.
+uint32_t recordCheck(const IndexRecord& record) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(IndexRecord, check); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool recordValid(const IndexRecord& record, uint64_t dataSize) {
+    uint64_t length = static_cast<uint64_t>(record.sourceLength) + record.dataLength;
+    return record.check == recordCheck(record) && record.offset >= sizeof(DataHeader) && record.offset <= dataSize &&
+           length <= dataSize - record.offset;
+}
+
+FileOperationException archiveError(const std::string& path, const std::string& reason) {
+    return FileOperationException("Invalid face archive " + path + ": " + reason);
+}
+
+// Thin wrappers over the platform's positioned file calls; each throws FileOperationException on failure.
+#if defined(_WIN32)
+using FileHandle = HANDLE;
+
+FileHandle openFile(const std::string& filename, bool writable) {
+    HANDLE file = CreateFileA(filename.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw FileOperationException("Cannot open file: " + filename);
+    }
+    return file;
+}
+
+void closeFile(FileHandle file) {
+    CloseHandle(file);
+}
+
+uint64_t fileSize(FileHandle file, const std::string& filename) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        throw FileOperationException("Failed to read file: " + filename);
+    }
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+void truncateFile(FileHandle file, const std::string& filename, uint64_t size) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+        throw FileOperationException("Failed to truncate file: " + filename);
+    }
+}
+
+OVERLAPPED overlappedAt(uint64_t offset) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    return overlapped;
+}
+
+void writeAt(FileHandle file, const std::string& filename, const void* data, size_t size, uint64_t offset) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while (size > 0) {
+        OVERLAPPED overlapped = overlappedAt(offset);
+        DWORD written = 0;
+        if (!WriteFile(file, bytes, static_cast<DWORD>(std::min<size_t>(size, 1u << 30)), &written, &overlapped)) {
+            throw FileOperationException("Failed to write file: " + filename);
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+void writeAt(FileHandle file, const std::string& filename, const void* first, size_t firstSize, const void* second,
+             size_t secondSize, uint64_t offset) {
+    writeAt(file, filename, first, firstSize, offset);
+    writeAt(file, filename, second, secondSize, offset + firstSize);
+}
+
+void readAt(FileHandle file, const std::string& filename, void* data, size_t size, uint64_t offset) {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    while (size > 0) {
+        OVERLAPPED overlapped = overlappedAt(offset);
+        DWORD count = 0;
+        if (!ReadFile(file, bytes, static_cast<DWORD>(std::min<size_t>(size, 1u << 30)), &count, &overlapped) || count == 0) {
+            throw FileOperationException("Failed to read file: " + filename);
+        }
+        bytes += count;
+        size -= count;
+        offset += count;
+    }
+}
+
+void syncFile(FileHandle file, const std::string& filename) {
+    if (!FlushFileBuffers(file)) {
+        throw FileOperationException("Failed to sync file: " + filename);
+    }
+}
+#else
+using FileHandle = int;
+
+FileHandle openFile(const std::string& filename, bool writable) {
+    int file = ::open(filename.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0666);
+    if (file < 0) {
+        throw FileOperationException("Cannot open file: " + filename);
+    }
+    return file;
+}
+
+void closeFile(FileHandle file) {
+    ::close(file);
+}
+
+uint64_t fileSize(FileHandle file, const std::string& filename) {
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        throw FileOperationException("Failed to read file: " + filename);
+    }
+    return static_cast<uint64_t>(info.st_size);
+}
+
+void truncateFile(FileHandle file, const std::string& filename, uint64_t size) {
+    if (ftruncate(file, static_cast<off_t>(size)) != 0) {
+        throw FileOperationException("Failed to truncate file: " + filename);
+    }
+}
+
+// Both buffers go out in one pwritev, so an append costs one system call for its data.
+void writeAt(FileHandle file, const std::string& filename, const void* first, size_t firstSize, const void* second,
+             size_t secondSize, uint64_t offset) {
+    iovec parts[2] = {{const_cast<void*>(first), firstSize}, {const_cast<void*>(second), secondSize}};
+    iovec* part = parts;
+    int partCount = 2;
+    while (partCount > 0) {
+        ssize_t written = ::pwritev(file, part, partCount, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw FileOperationException("Failed to write file: " + filename);
+        }
+        offset += static_cast<uint64_t>(written);
+        size_t remaining = static_cast<size_t>(written);
+        while (partCount > 0 && remaining >= part->iov_len) {
+            remaining -= part->iov_len;
+            ++part;
+            --partCount;
+        }
+        if (partCount > 0) {
+            part->iov_base = static_cast<unsigned char*>(part->iov_base) + remaining;
+            part->iov_len -= remaining;
+        }
+    }
+}
+
+void writeAt(FileHandle file, const std::string& filename, const void* data, size_t size, uint64_t offset) {
+    writeAt(file, filename, data, size, nullptr, 0, offset);
+}
+
+void readAt(FileHandle file, const std::string& filename, void* data, size_t size, uint64_t offset) {
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    while (size > 0) {
+        ssize_t count = ::pread(file, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            throw FileOperationException("Failed to read file: " + filename);
+        }
+        bytes += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+}
+
+void syncFile(FileHandle file, const std::string& filename) {
+    if (::fsync(file) != 0) {
+        throw FileOperationException("Failed to sync file: " + filename);
+    }
+}
+#endif
+
+void checkIndexHeader(const std::string& path, const unsigned char* bytes, uint64_t size) {
+    IndexHeader header;
+    if (size < sizeof(header)) {
+        throw archiveError(path, "index too short");
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0) {
+        throw archiveError(path, "not a FaceLib archive index");
+    }
+    if (header.version != archiveVersion || header.byteOrder != archiveByteOrder || header.recordSize != sizeof(IndexRecord)) {
+        throw archiveError(path, "unsupported format version or byte order");
+    }
+}
+
+void checkDataHeader(const std::string& path, const unsigned char* bytes, uint64_t size) {
+    DataHeader header;
+    if (size < sizeof(header)) {
+        throw archiveError(path, "data file too short");
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, dataMagic, sizeof(dataMagic)) != 0) {
+        throw archiveError(path, "not a FaceLib archive data file");
+    }
+    if (header.version != archiveVersion || header.byteOrder != archiveByteOrder) {
+        throw archiveError(path, "unsupported format version or byte order");
+    }
+}
+
+} // namespace
+
+class FaceArchiveWriter {
+public:
+    explicit FaceArchiveWriter(const std::string& path) : dataPath(path), recordsPath(indexPath(path)) {
+        dataFile = openFile(dataPath, true);
+        try {
+            indexFile = openFile(recordsPath, true);
+        } catch (...) {
+            closeFile(dataFile);
+            throw;
+        }
+        try {
+            prepare();
+        } catch (...) {
+            closeFile(dataFile);
+            closeFile(indexFile);
+            throw;
+        }
+    }
+
+    ~FaceArchiveWriter() {
+        closeFile(dataFile);
+        closeFile(indexFile);
+    }
+
+    void append(const std::string& sourceId, const FaceRect& face, const void* data, size_t size) {
+        if (sourceId.size() > UINT32_MAX || size > UINT32_MAX) {
+            throw FileOperationException("Face archive entry too large: " + sourceId);
+        }
+
+        IndexRecord record = {};
+        record.sourceLength = static_cast<uint32_t>(sourceId.size());
+        record.dataLength = static_cast<uint32_t>(size);
+        record.x = face.x;
+        record.y = face.y;
+        record.width = face.width;
+        record.height = face.height;
+
+        uint64_t slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            record.offset = dataEnd;
+            dataEnd += record.sourceLength + static_cast<uint64_t>(record.dataLength);
+            slot = recordCount++;
+        }
+        record.check = recordCheck(record);
+
+        writeAt(dataFile, dataPath, sourceId.data(), sourceId.size(), data, size, record.offset);
+        writeAt(indexFile, recordsPath, &record, sizeof(record), sizeof(IndexHeader) + slot * sizeof(IndexRecord));
+        FACELIB_TRACE("Appended " << size << " bytes for " << sourceId << " to face archive " << dataPath);
+    }
+
+    void sync() {
+        syncFile(dataFile, dataPath);
+        syncFile(indexFile, recordsPath);
+    }
+
+private:
+    // Writes the headers of a new archive, or checks those of an existing one and continues after its
+    // last whole record and the end of its data.
+    void prepare() {
+        uint64_t dataSize = fileSize(dataFile, dataPath);
+        uint64_t indexSize = fileSize(indexFile, recordsPath);
+        if (dataSize == 0 && indexSize == 0) {
+            DataHeader dataHeader = {};
+            std::memcpy(dataHeader.magic, dataMagic, sizeof(dataMagic));
+            dataHeader.version = archiveVersion;
+            dataHeader.byteOrder = archiveByteOrder;
+            writeAt(dataFile, dataPath, &dataHeader, sizeof(dataHeader), 0);
+
+            IndexHeader indexHeader = {};
+            std::memcpy(indexHeader.magic, indexMagic, sizeof(indexMagic));
+            indexHeader.version = archiveVersion;
+            indexHeader.byteOrder = archiveByteOrder;
+            indexHeader.recordSize = sizeof(IndexRecord);
+            writeAt(indexFile, recordsPath, &indexHeader, sizeof(indexHeader), 0);
+
+            dataEnd = sizeof(DataHeader);
+            return;
+        }
+
+        unsigned char header[sizeof(IndexHeader)] = {};
+        readAt(dataFile, dataPath, header, std::min<uint64_t>(dataSize, sizeof(DataHeader)), 0);
+        checkDataHeader(dataPath, header, dataSize);
+        readAt(indexFile, recordsPath, header, std::min<uint64_t>(indexSize, sizeof(IndexHeader)), 0);
+        checkIndexHeader(recordsPath, header, indexSize);
+
+        // A record torn off at the end of the index is dropped, so new records line up again.
+        recordCount = (indexSize - sizeof(IndexHeader)) / sizeof(IndexRecord);
+        uint64_t wholeRecords = sizeof(IndexHeader) + recordCount * sizeof(IndexRecord);
+        if (wholeRecords != indexSize) {
+            truncateFile(indexFile, recordsPath, wholeRecords);
+        }
+        dataEnd = dataSize;
+    }
+
+    std::string dataPath;
+    std::string recordsPath;
+    FileHandle dataFile;
+    FileHandle indexFile;
+
+    std::mutex mutex;
+    uint64_t dataEnd = 0;
+    uint64_t recordCount = 0;
+};
+
+class FaceArchiveReader {
+public:
+    explicit FaceArchiveReader(const std::string& path) : dataPath(path) {
+        // The records are copied out, so only the data file stays mapped.
+        const std::string recordsPath = indexPath(path);
+        MappedFile index = MappedFile::open(recordsPath, true);
+        data = MappedFile::open(dataPath, true);
+        checkIndexHeader(recordsPath, index.data(), index.size());
+        checkDataHeader(dataPath, data.data(), data.size());
+
+        // Records whose writes never completed, or whose data is past what was mapped, are skipped.
+        size_t count = (index.size() - sizeof(IndexHeader)) / sizeof(IndexRecord);
+        records.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            IndexRecord record;
+            std::memcpy(&record, index.data() + sizeof(IndexHeader) + i * sizeof(IndexRecord), sizeof(record));
+            if (recordValid(record, data.size())) {
+                records.push_back(record);
+            }
+        }
+        if (records.size() != count) {
+            FACELIB_LOG_WARNING("Face archive " << path << ": skipped " << count - records.size() << " incomplete record(s)");
+        }
+
+        file = openFile(dataPath, false);
+    }
+
+    ~FaceArchiveReader() {
+        closeFile(file);
+    }
+
+    const IndexRecord& record(size_t i) const {
+        if (i >= records.size()) {
+            throw FileOperationException("Face archive index " + std::to_string(i) + " out of range: " + dataPath);
+        }
+        return records[i];
+    }
+
+    std::string dataPath;
+    MappedFile data;
+    std::vector<IndexRecord> records;
+    FileHandle file;
+};
+
+FACELIB_API FaceArchiveWriterHandle openFaceArchiveWriter(const std::string& path) {
+    return FaceArchiveWriterHandle(new FaceArchiveWriter(path));
+}
+
+FACELIB_API void deleteFaceArchiveWriter(FaceArchiveWriter* writer) {
+    delete writer;
+}
+
+void FaceArchiveWriterDeleter::operator()(FaceArchiveWriter* writer) const {
+    deleteFaceArchiveWriter(writer);
+}
+
+FACELIB_API void appendFace(FaceArchiveWriter* writer, const std::string& sourceId, const FaceRect& face,
+                            const void* data, size_t size) {
+    if (!writer) {
+        throw FileOperationException("Face archive writer is null");
+    }
+    writer->append(sourceId, face, data, size);
+}
+
+FACELIB_API void appendFace(FaceArchiveWriter* writer, const std::string& sourceId, const FaceRect& face,
+                            const std::vector<unsigned char>& data) {
+    appendFace(writer, sourceId, face, data.data(), data.size());
+}
+
+FACELIB_API void syncFaceArchive(FaceArchiveWriter* writer) {
+    if (!writer) {
+        throw FileOperationException("Face archive writer is null");
+    }
+    writer->sync();
+}
+
+FACELIB_API FaceArchiveReaderHandle openFaceArchive(const std::string& path) {
+    FaceArchiveReaderHandle reader(new FaceArchiveReader(path));
+    FACELIB_LOG_INFO("Opened face archive " << path << " with " << reader->records.size() << " face(s)");
+    return reader;
+}
+
+FACELIB_API void deleteFaceArchiveReader(FaceArchiveReader* reader) {
+    delete reader;
+}
+
+void FaceArchiveReaderDeleter::operator()(FaceArchiveReader* reader) const {
+    deleteFaceArchiveReader(reader);
+}
+
+FACELIB_API size_t getArchiveFaceCount(const FaceArchiveReader* reader) {
+    if (!reader) {
+        throw FileOperationException("Face archive reader is null");
+    }
+    return reader->records.size();
+}
+
+FACELIB_API ArchivedFace getArchivedFace(const FaceArchiveReader* reader, size_t index) {
+    if (!reader) {
+        throw FileOperationException("Face archive reader is null");
+    }
+    const IndexRecord& record = reader->record(index);
+    ArchivedFace face;
+    face.sourceId.assign(reinterpret_cast<const char*>(reader->data.data() + record.offset), record.sourceLength);
+    face.face = FaceRect(record.x, record.y, record.width, record.height);
+    face.offset = record.offset + record.sourceLength;
+    face.size = record.dataLength;
+    return face;
+}
+
+FACELIB_API const unsigned char* getArchiveFaceData(const FaceArchiveReader* reader, size_t index, size_t& size) {
+    if (!reader) {
+        throw FileOperationException("Face archive reader is null");
+    }
+    const IndexRecord& record = reader->record(index);
+    size = record.dataLength;
+    return reader->data.data() + record.offset + record.sourceLength;
+}
+
+FACELIB_API void readArchiveFace(const FaceArchiveReader* reader, size_t index, std::vector<unsigned char>& output) {
+    if (!reader) {
+        throw FileOperationException("Face archive reader is null");
+    }
+    const IndexRecord& record = reader->record(index);
+    output.resize(record.dataLength);
+    readAt(reader->file, reader->dataPath, output.data(), output.size(), record.offset + record.sourceLength);
+}
@@ -0,0 +1,631 @@
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
+#include "ThreadPool.h"
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+// Process-wide default detector used by loadHaarCascade() and the detectFaces() overload without a detector.
+// Callers take a shared_ptr copy, so a concurrent loadHaarCascade() never pulls a detector out from under them.
+static std::shared_ptr<const FaceDetector> defaultDetector;
+static std::mutex defaultDetectorMutex;
+
+std::shared_ptr<const FaceDetector> getDefaultDetector() {
+    std::lock_guard<std::mutex> lock(defaultDetectorMutex);
+    if (!defaultDetector) {
+        throw FaceDetectionException("Haar cascade not loaded. Call loadHaarCascade() first.");
+    }
+    return defaultDetector;
+}
+
+// Face detection functions
+FACELIB_API bool loadHaarCascade(const std::string& cascadePath) {
+    try {
+        auto detector = std::make_shared<const FaceDetector>(cascadePath);
+        {
+            std::lock_guard<std::mutex> lock(defaultDetectorMutex);
+            defaultDetector = std::move(detector);
+        }
+        FACELIB_LOG_INFO("Haar cascade loaded successfully from: " << cascadePath);
+        return true;
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error loading cascade: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API bool loadHaarCascades(const std::vector<std::string>& cascadePaths, const EnsembleOptions& options) {
+    try {
+        auto detector = std::make_shared<const FaceDetector>(cascadePaths, options, DetectorBackend::Auto);
+        {
+            std::lock_guard<std::mutex> lock(defaultDetectorMutex);
+            defaultDetector = std::move(detector);
+        }
+        FACELIB_LOG_INFO("Loaded ensemble of " << cascadePaths.size() << " Haar cascade(s)");
+        return true;
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error loading cascade: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API FaceDetectorHandle createFaceDetector(const std::string& modelPath, DetectorBackend backend) {
+    try {
+        return FaceDetectorHandle(new FaceDetector(modelPath, backend));
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error loading cascade: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API FaceDetectorHandle createEnsembleDetector(const std::vector<std::string>& cascadePaths, const EnsembleOptions& options) {
+    try {
+        return FaceDetectorHandle(new FaceDetector(cascadePaths, options, DetectorBackend::Auto));
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error loading cascade: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API DetectorBackend getDetectorBackend(const FaceDetector* detector) {
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    return detector->detectorBackend();
+}
+
+FACELIB_API bool isDetectorBackendAvailable(DetectorBackend backend) {
+#ifdef FACELIB_WITH_XOBJDETECT
+    (void)backend;
+    return true;
+#else
+    return backend != DetectorBackend::WaldBoost;
+#endif
+}
+
+FACELIB_API void deleteFaceDetector(FaceDetector* detector) {
+    delete detector;
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, double scaleFactor, int minNeighbors, int minSize) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFaces(detector.get(), image, scaleFactor, minNeighbors, minSize);
+}
+
+// One level of a detection pyramid: the grayscale image scaled down by factor.
+struct PyramidLevel {
+    float factor;
+    cv::Mat image;
+};
+
+// Grayscale conversion of image, computed once per cache. Called with cache.mutex held.
+static const cv::Mat& cachedGray(PyramidCache& cache, const cv::Mat& image) {
+    if (cache.gray.empty()) {
+        cv::Mat scratch;
+        cache.gray = toGray(image, scratch);
+    }
+    return cache.gray;
+}
+
+// Fills in the levels detectMultiScale would scan, taking them from cache where it already has them,
+// then trims the cache back to PyramidCache::maxLevels. The scales follow OpenCV's own pyramid: the window grows by scaleFactor from the cascade's size,
+// windows smaller than minSize are skipped and the pyramid ends once the window outgrows the image or
+// maxSize (0 for no limit).
+static std::vector<PyramidLevel> cachedPyramid(PyramidCache& cache, const cv::Mat& image, cv::Size window,
+                                               double scaleFactor, int minSize, int maxSize) {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cachedGray(cache, image);
+
+    std::vector<PyramidLevel> levels;
+    size_t reused = 0;
+    const uint64_t use = ++cache.uses;
+    cv::Size imageSize = cache.gray.size();
+    for (double factor = 1; ; factor *= scaleFactor) {
+        cv::Size windowSize(cvRound(window.width * factor), cvRound(window.height * factor));
+        if (windowSize.width > imageSize.width || windowSize.height > imageSize.height) {
+            break;
+        }
+        if (maxSize > 0 && (windowSize.width > maxSize || windowSize.height > maxSize)) {
+            break;
+        }
+        if (windowSize.width < minSize || windowSize.height < minSize) {
+            continue;
+        }
+
+        float scale = static_cast<float>(factor);
+        cv::Size levelSize(cvRound(imageSize.width / scale), cvRound(imageSize.height / scale));
+        if (levelSize.width < window.width || levelSize.height < window.height) {
+            break;
+        }
+        if (levelSize == imageSize) {
+            levels.push_back({scale, cache.gray});
+            continue;
+        }
+
+        PyramidCache::Level& level = cache.levels[{levelSize.width, levelSize.height}];
+        if (level.image.empty()) {
+            cv::resize(cache.gray, level.image, levelSize, 0, 0, cv::INTER_LINEAR_EXACT);
+        } else {
+            ++reused;
+        }
+        level.lastUse = use;
+        levels.push_back({scale, level.image});
+    }
+
+    // The returned levels hold their own references, so evicting them here is safe.
+    while (cache.levels.size() > PyramidCache::maxLevels) {
+        auto oldest = std::min_element(cache.levels.begin(), cache.levels.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUse < b.second.lastUse;
+        });
+        cache.levels.erase(oldest);
+    }
+
+    FACELIB_TRACE("Pyramid cache: reused " << reused << " of " << levels.size() << " level(s)");
+    return levels;
+}
+
+// One pyramid level to be scanned by one cascade of a detector.
+struct LevelScan {
+    size_t cascade;
+    PyramidLevel level;
+    cv::Size windowSize;
+};
+
+void scanPyramidLevel(const FaceDetector::Lease& classifiers, size_t cascade, const cv::Mat& level, float factor,
+                      NativeScratch& scratch, std::vector<cv::Rect>& hits) {
+    if (const NativeCascade* native = classifiers.detector().nativeCascade(cascade)) {
+        scanNativeLevel(*native, level, factor, scratch, hits);
+        return;
+    }
+    cv::CascadeClassifier& classifier = classifiers[cascade];
+    cv::Size window = classifier.getOriginalWindowSize();
+    cv::Size windowSize(cvRound(window.width * factor), cvRound(window.height * factor));
+    std::vector<cv::Rect> levelHits;
+    classifier.detectMultiScale(level, levelHits, 1.1, 0, 0, window, window);
+    for (const auto& hit : levelHits) {
+        hits.emplace_back(cvRound(hit.x * factor), cvRound(hit.y * factor), windowSize.width, windowSize.height);
+    }
+}
+
+static void scanLevel(const FaceDetector::Lease& classifiers, const LevelScan& scan, std::vector<cv::Rect>& hits) {
+    scanPyramidLevel(classifiers, scan.cascade, scan.level.image, scan.level.factor, classifiers.scratch(), hits);
+}
+
+static void sortLargestFirst(std::vector<cv::Rect>& faces) {
+    std::stable_sort(faces.begin(), faces.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.area() > b.area(); });
+}
+
+static double overlap(const cv::Rect& a, const cv::Rect& b) {
+    double intersection = (a & b).area();
+    return intersection > 0 ? intersection / (a.area() + b.area() - intersection) : 0.0;
+}
+
+std::vector<cv::Rect> suppressOverlaps(const std::vector<cv::Rect>& faces, const std::vector<double>& scores, double threshold) {
+    std::vector<size_t> order(faces.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+    std::vector<cv::Rect> kept;
+    for (size_t index : order) {
+        bool duplicate = std::any_of(kept.begin(), kept.end(), [&](const cv::Rect& face) {
+            return overlap(face, faces[index]) > threshold;
+        });
+        if (!duplicate) {
+            kept.push_back(faces[index]);
+        }
+    }
+    return kept;
+}
+
+std::vector<cv::Rect> mergeCascadeHits(const FaceDetector& detector, std::vector<std::vector<cv::Rect>>& hits, int minNeighbors) {
+    std::vector<cv::Rect> faces;
+    if (hits.size() == 1) {
+        faces.swap(hits[0]);
+        cv::groupRectangles(faces, minNeighbors, 0.2);
+        return faces;
+    }
+
+    const EnsembleOptions& options = detector.ensembleOptions();
+    if (options.merge == EnsembleMerge::Pooled) {
+        for (const auto& cascadeHits : hits) {
+            faces.insert(faces.end(), cascadeHits.begin(), cascadeHits.end());
+        }
+        cv::groupRectangles(faces, minNeighbors, options.groupEps);
+        return faces;
+    }
+
+    // Faces from different cascades are ranked by their neighbour counts.
+    std::vector<double> support;
+    for (auto& cascadeHits : hits) {
+        std::vector<int> weights;
+        cv::groupRectangles(cascadeHits, weights, minNeighbors, options.groupEps);
+        faces.insert(faces.end(), cascadeHits.begin(), cascadeHits.end());
+        support.insert(support.end(), weights.begin(), weights.end());
+    }
+    return suppressOverlaps(faces, support, options.overlapThreshold);
+}
+
+// Runs every cascade over one shared pyramid - the image's cache, or a temporary one built on the
+// caller's grayscale buffer when there is none - and merges the results.
+// With maxFaces set the levels are scanned from the largest window down. Once enough faces are found,
+// scanning goes on only while the window is still large enough to be grouped directly with the smallest
+// of them. groupRectangles clusters transitively, so hits on the skipped levels could still have joined
+// a kept face through an intermediate one: its neighbour count and averaged rectangle can differ
+// slightly from a full scan.
+static std::vector<cv::Rect> detectOnPyramid(const FaceDetector::Lease& classifiers, const ImageData& image,
+                                             std::shared_ptr<PyramidCache> cache, cv::Mat& grayScratch, const DetectOptions& options) {
+    if (!cache) {
+        cache = std::make_shared<PyramidCache>();
+        cache->gray = toGray(image.mat, grayScratch);
+    }
+
+    std::vector<LevelScan> scans;
+    for (size_t i = 0; i < classifiers.size(); ++i) {
+        cv::Size window = classifiers.detector().cascadeWindow(i);
+        std::vector<PyramidLevel> levels = cachedPyramid(*cache, image.mat, window, options.scaleFactor, options.minSize, options.maxSize);
+        size_t first = 0;
+        if (options.maxLevels > 0 && levels.size() > static_cast<size_t>(options.maxLevels)) {
+            first = levels.size() - options.maxLevels;  // keep the largest scales
+        }
+        for (size_t level = first; level < levels.size(); ++level) {
+            cv::Size windowSize(cvRound(window.width * levels[level].factor), cvRound(window.height * levels[level].factor));
+            scans.push_back({i, levels[level], windowSize});
+        }
+    }
+
+    const FaceDetector& detector = classifiers.detector();
+    std::vector<std::vector<cv::Rect>> hits(classifiers.size());
+    std::vector<std::vector<cv::Rect>> grouped;
+    if (options.maxFaces <= 0) {
+        for (const LevelScan& scan : scans) {
+            scanLevel(classifiers, scan, hits[scan.cascade]);
+        }
+        return mergeCascadeHits(detector, hits, options.minNeighbors);
+    }
+
+    std::stable_sort(scans.begin(), scans.end(), [](const LevelScan& a, const LevelScan& b) {
+        return a.windowSize.width > b.windowSize.width;
+    });
+    double groupEps = detector.cascadeCount() > 1 ? detector.ensembleOptions().groupEps : 0.2;
+    size_t maxFaces = static_cast<size_t>(options.maxFaces);
+    double stopBelow = 0;
+    size_t scanned = 0;
+    for (const LevelScan& scan : scans) {
+        if (scan.windowSize.width < stopBelow) {
+            break;
+        }
+        scanLevel(classifiers, scan, hits[scan.cascade]);
+        ++scanned;
+        if (stopBelow == 0) {
+            grouped = hits;
+            std::vector<cv::Rect> faces = mergeCascadeHits(detector, grouped, options.minNeighbors);
+            if (faces.size() >= maxFaces) {
+                // groupRectangles joins windows whose sides differ by up to 2 * eps of the smaller one;
+                // chains through smaller windows are cut off here, which is the approximation.
+                sortLargestFirst(faces);
+                stopBelow = faces[maxFaces - 1].width / (1 + 2 * groupEps);
+            }
+        }
+    }
+    FACELIB_TRACE("Scanned " << scanned << " of " << scans.size() << " pyramid level(s)");
+
+    std::vector<cv::Rect> faces = mergeCascadeHits(detector, hits, options.minNeighbors);
+    sortLargestFirst(faces);
+    if (faces.size() > maxFaces) {
+        faces.resize(maxFaces);
+    }
+    return faces;
+}
+
+// Runs the detector's cascades on one image. cache is the image's pyramid cache, or null to build
+// everything for this call only. grayScratch receives the grayscale conversion and is kept by the caller
+// so repeated calls on the same thread reuse its allocation.
+// With a pyramid cache, several cascades, or a level or face limit, every level is scanned on its own at
+// exactly the cascade window size and the raw hits of all levels are grouped together as
+// detectMultiScale does; binary cascades always take this path. Otherwise detectMultiScale runs on the
+// whole image.
+static std::vector<FaceRect> detectWithClassifier(const FaceDetector::Lease& classifiers, const ImageData& image,
+                                                  const std::shared_ptr<PyramidCache>& cache, cv::Mat& grayScratch,
+                                                  const DetectOptions& options) {
+    std::vector<cv::Rect> faces;
+    if (const WaldBoostModel* waldboost = classifiers.detector().waldBoostModel()) {
+        if (cache) {
+            cv::Mat gray;
+            {
+                std::lock_guard<std::mutex> lock(cache->mutex);
+                gray = cachedGray(*cache, image.mat);
+            }
+            faces = detectWaldBoost(*waldboost, gray, options.minSize);
+        } else {
+            faces = detectWaldBoost(*waldboost, toGray(image.mat, grayScratch), options.minSize);
+        }
+        if (options.maxSize > 0) {
+            faces.erase(std::remove_if(faces.begin(), faces.end(), [&](const cv::Rect& face) {
+                return face.width > options.maxSize || face.height > options.maxSize;
+            }), faces.end());
+        }
+        if (options.maxFaces > 0 && faces.size() > static_cast<size_t>(options.maxFaces)) {
+            sortLargestFirst(faces);
+            faces.resize(options.maxFaces);
+        }
+    } else if (cache || classifiers.size() > 1 || options.maxLevels > 0 || options.maxFaces > 0 ||
+               classifiers.detector().hasNativeCascade()) {
+        faces = detectOnPyramid(classifiers, image, cache, grayScratch, options);
+    } else {
+        // Convert to grayscale if needed
+        const cv::Mat& grayImage = toGray(image.mat, grayScratch);
+
+        // Detect faces
+        classifiers[0].detectMultiScale(
+            grayImage,
+            faces,
+            options.scaleFactor,
+            options.minNeighbors,
+            0,
+            cv::Size(options.minSize, options.minSize),
+            cv::Size(options.maxSize, options.maxSize)
+        );
+    }
+
+    // Convert cv::Rect to FaceRect
+    std::vector<FaceRect> result;
+    result.reserve(faces.size());
+    for (const auto& face : faces) {
+        result.emplace_back(face.x, face.y, face.width, face.height);
+    }
+    return result;
+}
+
+void checkScaleFactor(double scaleFactor) {
+    if (!(scaleFactor > 1)) {  // also catches NaN
+        throw FaceDetectionException("scaleFactor must be greater than 1, got " + std::to_string(scaleFactor));
+    }
+}
+
+static DetectOptions makeDetectOptions(double scaleFactor, int minNeighbors, int minSize) {
+    DetectOptions options;
+    options.scaleFactor = scaleFactor;
+    options.minNeighbors = minNeighbors;
+    options.minSize = minSize;
+    return options;
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const DetectOptions& options) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFaces(detector.get(), image, options);
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, double scaleFactor, int minNeighbors, int minSize) {
+    return detectFaces(detector, image, makeDetectOptions(scaleFactor, minNeighbors, minSize));
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const DetectOptions& options) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    checkScaleFactor(options.scaleFactor);
+
+    try {
+        // Detect on classifiers leased for the duration of this call
+        FaceDetector::Lease classifiers(*detector);
+        cv::Mat grayImage;
+        std::vector<FaceRect> result = detectWithClassifier(classifiers, *image, image->pyramidCache(), grayImage, options);
+
+        FACELIB_LOG_INFO("Detected " << result.size() << " face(s)");
+        return result;
+
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error during face detection: " + std::string(e.what()));
+    }
+}
+
+FACELIB_API std::vector<std::vector<FaceRect>> detectFacesBatch(const std::vector<const ImageData*>& images, double scaleFactor, int minNeighbors, int minSize) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFacesBatch(detector.get(), images, scaleFactor, minNeighbors, minSize);
+}
+
+FACELIB_API std::vector<std::vector<FaceRect>> detectFacesBatch(const FaceDetector* detector, const std::vector<const ImageData*>& images, double scaleFactor, int minNeighbors, int minSize) {
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    checkScaleFactor(scaleFactor);
+
+    std::vector<std::vector<FaceRect>> results(images.size());
+    std::vector<std::exception_ptr> errors(images.size());
+
+    // Per-slot worker state: each thread keeps one leased classifier set (and with it OpenCV's
+    // integral and pyramid buffers) plus one grayscale buffer reused for every image it processes.
+    // Batch images are detected once, so their pyramid caches are left alone.
+    struct WorkerState {
+        std::unique_ptr<FaceDetector::Lease> classifiers;
+        cv::Mat grayImage;
+    };
+
+    DetectOptions options = makeDetectOptions(scaleFactor, minNeighbors, minSize);
+    std::shared_ptr<ThreadPool> pool = getSharedThreadPool();
+    std::vector<WorkerState> workers(pool->concurrency());
+
+    pool->parallelFor(images.size(), [&](size_t index, size_t slot) {
+        try {
+            const ImageData* image = images[index];
+            if (!image || image->mat.empty()) {
+                throw ImageProcessingException("Cannot detect faces in empty or null image at batch index " + std::to_string(index));
+            }
+
+            WorkerState& worker = workers[slot];
+            if (!worker.classifiers) {
+                worker.classifiers = std::make_unique<FaceDetector::Lease>(*detector);
+            }
+            results[index] = detectWithClassifier(*worker.classifiers, *image, nullptr, worker.grayImage, options);
+            FACELIB_TRACE("Batch image " << index << " on slot " << slot << ": " << results[index].size() << " face(s)");
+        } catch (const cv::Exception& e) {
+            errors[index] = std::make_exception_ptr(FaceDetectionException("OpenCV error during face detection: " + std::string(e.what())));
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    FACELIB_LOG_INFO("Detected faces in batch of " << images.size() << " image(s)");
+    return results;
+}
+
+FACELIB_API void enablePyramidCache(ImageData* image, bool enable) {
+    if (!image) {
+        throw ImageProcessingException("Cannot configure pyramid cache of null image");
+    }
+    image->pyramidCacheEnabled = enable;
+    if (!enable) {
+        image->dropPyramid();
+    }
+}
+
+FACELIB_API void notifyImageModified(ImageData* image) {
+    if (image) {
+        image->dropPyramid();
+    }
+}
+
+// Encoded streams that the JPEG codec can decode at 1/2, 1/4 or 1/8 scale during the inverse DCT.
+static bool isJpeg(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    return size >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF;
+}
+
+// Largest decode reduction at which a face of minSize pixels still covers the cascade window.
+static int chooseDecodeScale(int minSize, cv::Size window) {
+    int windowSide = std::max(window.width, window.height);
+    for (int scale : {8, 4, 2}) {
+        if (minSize / scale >= windowSide) {
+            return scale;
+        }
+    }
+    return 1;
+}
+
+static Image decodeForDetection(const void* data, size_t size, int minSize, int& decodeScale, const FaceDetector& detector) {
+    // Other codecs would decode at full size and resize afterwards, which costs more than it saves;
+    // they are decoded to grayscale at full resolution instead.
+    decodeScale = isJpeg(data, size) ? chooseDecodeScale(minSize, detector.windowSize()) : 1;
+    int flags = cv::IMREAD_GRAYSCALE;
+    switch (decodeScale) {
+        case 2: flags = cv::IMREAD_REDUCED_GRAYSCALE_2; break;
+        case 4: flags = cv::IMREAD_REDUCED_GRAYSCALE_4; break;
+        case 8: flags = cv::IMREAD_REDUCED_GRAYSCALE_8; break;
+        default: break;
+    }
+
+    Image image = createImage();
+    decodeInto(data, size, flags, image.get());
+    FACELIB_TRACE("Decoded " << image->mat.cols << "x" << image->mat.rows << " for detection at 1/" << decodeScale << " scale");
+    return image;
+}
+
+FACELIB_API Image loadImageForDetection(const void* data, size_t size, int minSize, int& decodeScale, const FaceDetector* detector) {
+    if (detector) {
+        return decodeForDetection(data, size, minSize, decodeScale, *detector);
+    }
+    std::shared_ptr<const FaceDetector> defaultDetector = getDefaultDetector();
+    return decodeForDetection(data, size, minSize, decodeScale, *defaultDetector);
+}
+
+FACELIB_API std::vector<FaceRect> scaleFaceRects(const std::vector<FaceRect>& faces, int factor) {
+    std::vector<FaceRect> scaled;
+    scaled.reserve(faces.size());
+    for (const auto& face : faces) {
+        scaled.emplace_back(face.x * factor, face.y * factor, face.width * factor, face.height * factor);
+    }
+    return scaled;
+}
+
+FACELIB_API std::vector<FaceRect> detectFacesInEncoded(const void* data, size_t size, double scaleFactor, int minNeighbors, int minSize) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFacesInEncoded(detector.get(), data, size, scaleFactor, minNeighbors, minSize);
+}
+
+FACELIB_API std::vector<FaceRect> detectFacesInEncoded(const FaceDetector* detector, const void* data, size_t size,
+                                                       double scaleFactor, int minNeighbors, int minSize) {
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+
+    int decodeScale = 1;
+    Image reduced = decodeForDetection(data, size, minSize, decodeScale, *detector);
+    std::vector<FaceRect> faces = detectFaces(detector, reduced.get(), scaleFactor, minNeighbors, minSize / decodeScale);
+    return decodeScale == 1 ? faces : scaleFaceRects(faces, decodeScale);
+}
+
+// Returns the face with the largest area; faces must not be empty.
+static const FaceRect& findLargestFace(const std::vector<FaceRect>& faces) {
+    const FaceRect* largestFace = &faces[0];
+    int largestArea = largestFace->width * largestFace->height;
+
+    for (size_t i = 1; i < faces.size(); ++i) {
+        int area = faces[i].width * faces[i].height;
+        if (area > largestArea) {
+            largestArea = area;
+            largestFace = &faces[i];
+        }
+    }
+    return *largestFace;
+}
+
+FACELIB_API Image cropToLargestFace(const ImageData* image, double padding) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot crop empty or null image");
+    }
+
+    // Only the largest face is needed, so the scan stops once it has been found.
+    DetectOptions options;
+    options.maxFaces = 1;
+    std::vector<FaceRect> faces = detectFaces(image, options);
+    return cropToLargestFace(image, faces, padding);
+}
+
+FACELIB_API Image cropToLargestFace(const ImageData* image, const std::vector<FaceRect>& faces, double padding) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot crop empty or null image");
+    }
+
+    if (faces.empty()) {
+        throw FaceDetectionException("No faces detected in image");
+    }
+
+    FACELIB_LOG_INFO("Using largest face of " << faces.size() << " detected faces");
+
+    return cropToFace(image, findLargestFace(faces), padding);
+}
+
+FACELIB_API Image detectAndCropLargest(const ImageData* image, std::vector<FaceRect>& faces,
+                                            double scaleFactor, int minNeighbors, int minSize, double padding) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectAndCropLargest(detector.get(), image, faces, scaleFactor, minNeighbors, minSize, padding);
+}
+
+FACELIB_API Image detectAndCropLargest(const FaceDetector* detector, const ImageData* image, std::vector<FaceRect>& faces,
+                                            double scaleFactor, int minNeighbors, int minSize, double padding) {
+    faces = detectFaces(detector, image, scaleFactor, minNeighbors, minSize);
+    if (faces.empty()) {
+        return nullptr;
+    }
+    return cropToFace(image, findLargestFace(faces), padding);
+}
\ No newline at end of file
@@ -1,29 +1,10 @@
-#include "FaceLib.h"
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/objdetect.hpp>
 #include <algorithm>
-#include <iostream>
 #include <fstream>
-
-// Internal class to wrap cv::Mat - hidden from header
-class ImageData {
-public:
-    cv::Mat mat;
-
-    ImageData() = default;
-    explicit ImageData(const cv::Mat& image) : mat(image) {}
-    ImageData(const ImageData& other) : mat(other.mat.clone()) {}
-    ImageData& operator=(const ImageData& other) {
-        if (this != &other) {
-            mat = other.mat.clone();
-        }
-        return *this;
-    }
-};
-
-// Global Haar cascade classifier
-static cv::CascadeClassifier faceCascade;
-static bool cascadeLoaded = false;
+#include <limits>
 
 // File I/O functions
 FACELIB_API std::vector<unsigned char> readImageFile(const std::string& filename) {
@@ -43,47 +24,74 @@ FACELIB_API std::vector<unsigned char> readImageFile(const std::string& filename
     return buffer;
 }
 
-FACELIB_API void writeBinaryToFile(const std::vector<unsigned char>& binaryData, const std::string& filename) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) {
-        throw FileOperationException("Cannot create file: " + filename);
-    }
-
-    file.write(reinterpret_cast<const char*>(binaryData.data()), binaryData.size());
-    if (!file) {
-        throw FileOperationException("Failed to write binary data to file: " + filename);
-    }
-
-    std::cout << "Binary data written to file: " << filename << std::endl;
-}
-
 // Image processing functions
-FACELIB_API ImageData* loadImageFromFile(const std::string& filename) {
+FACELIB_API Image loadImageFromFile(const std::string& filename) {
     try {
         cv::Mat image = cv::imread(filename);
         if (image.empty()) {
             throw ImageLoadException(filename);
         }
-        return new ImageData(image);
+        return Image(new ImageData(image));
     } catch (const cv::Exception& e) {
         throw ImageLoadException(filename + " - OpenCV error: " + e.what());
     }
 }
 
 
-FACELIB_API ImageData* loadImageFromBinary(const std::vector<unsigned char>& imageData) {
+FACELIB_API Image loadImageFromBinary(const std::vector<unsigned char>& imageData) {
+    return loadImageFromMemory(imageData.data(), imageData.size());
+}
+
+FACELIB_API void loadImageFromBinary(const std::vector<unsigned char>& imageData, ImageData* output) {
+    loadImageFromMemory(imageData.data(), imageData.size(), output);
+}
+
+FACELIB_API Image loadImageFromMemory(const void* data, size_t size) {
+    Image image = createImage();
+    loadImageFromMemory(data, size, image.get());
+    return image;
+}
+
+void decodeInto(const void* data, size_t size, int flags, ImageData* output) {
+    if (!output) {
+        throw ImageProcessingException("Cannot decode into null image");
+    }
+    if (!data || size == 0 || size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw ImageProcessingException("Failed to decode image from binary data");
+    }
+
     try {
-        int flags = cv::IMREAD_UNCHANGED;  // Load image as-is, preserving alpha channel if present
-        cv::Mat image = cv::imdecode(imageData, flags);
+        // Header over the caller's bytes - imdecode reads them in place.
+        cv::Mat encoded(1, static_cast<int>(size), CV_8U, const_cast<void*>(data));
+        cv::Mat& image = output->output();
+        cv::imdecode(encoded, flags, &image);
         if (image.empty()) {
             throw ImageProcessingException("Failed to decode image from binary data");
         }
-        return new ImageData(image);
     } catch (const cv::Exception& e) {
         throw ImageProcessingException("OpenCV decode error: " + std::string(e.what()));
     }
 }
 
+FACELIB_API void loadImageFromMemory(const void* data, size_t size, ImageData* output) {
+    decodeInto(data, size, cv::IMREAD_UNCHANGED, output);  // Load image as-is, preserving alpha channel if present
+}
+
+FACELIB_API Image loadImageGrayFromBinary(const std::vector<unsigned char>& imageData) {
+    return loadImageGrayFromMemory(imageData.data(), imageData.size());
+}
+
+FACELIB_API Image loadImageGrayFromMemory(const void* data, size_t size) {
+    Image image = createImage();
+    loadImageGrayFromMemory(data, size, image.get());
+    return image;
+}
+
+FACELIB_API void loadImageGrayFromMemory(const void* data, size_t size, ImageData* output) {
+    // For JPEG, libjpeg outputs the luma component directly: chroma is never upsampled or colour converted.
+    decodeInto(data, size, cv::IMREAD_GRAYSCALE, output);
+}
+
 FACELIB_API void displayImage(const ImageData* image, const std::string& windowName, int waitTime) {
     if (!image || image->mat.empty()) {
         throw ImageProcessingException("Cannot display empty or null image");
@@ -106,44 +114,6 @@ FACELIB_API void closeAllWindows() {
     }
 }
 
-FACELIB_API std::vector<unsigned char> saveImageToBinary(const ImageData* image, const std::string& format) {
-    if (!image || image->mat.empty()) {
-        throw ImageProcessingException("Cannot save empty or null image");
-    }
-
-    std::vector<unsigned char> buffer;
-    std::vector<int> compression_params;
-
-    // Set compression parameters based on format
-    std::string ext = format;
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-
-    try {
-        if (ext == ".jpg" || ext == ".jpeg") {
-            compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
-            compression_params.push_back(95); // High quality (0-100)
-        } else if (ext == ".png") {
-            compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-            compression_params.push_back(1); // Low compression for better quality (0-9)
-        } else if (ext == ".webp") {
-            compression_params.push_back(cv::IMWRITE_WEBP_QUALITY);
-            compression_params.push_back(95); // High quality (1-100)
-        }
-
-        // Encode image to binary buffer
-        bool success = cv::imencode(format, image->mat, buffer, compression_params);
-
-        if (!success) {
-            throw ImageSaveException(format);
-        }
-
-        std::cout << "Image saved to binary format " << format << ". Size: " << buffer.size() << " bytes" << std::endl;
-        return buffer;
-    } catch (const cv::Exception& e) {
-        throw ImageSaveException(format + " - OpenCV error: " + e.what());
-    }
-}
-
 // Image utility functions
 FACELIB_API void getImageDimensions(const ImageData* image, int& width, int& height) {
     if (!image || image->mat.empty()) {
@@ -157,79 +127,92 @@ FACELIB_API bool isImageEmpty(const ImageData* image) {
     return !image || image->mat.empty();
 }
 
-FACELIB_API ImageData* copyImage(const ImageData* source) {
+FACELIB_API Image copyImage(const ImageData* source) {
     if (!source || source->mat.empty()) {
         throw ImageProcessingException("Cannot copy empty or null image");
     }
-    return new ImageData(*source);
+    return Image(new ImageData(*source));
 }
 
 FACELIB_API void deleteImage(ImageData* image) {
     delete image;
 }
 
-// Face detection functions
-FACELIB_API bool loadHaarCascade(const std::string& cascadePath) {
-    try {
-        cascadeLoaded = faceCascade.load(cascadePath);
-        if (!cascadeLoaded) {
-            throw FaceDetectionException("Failed to load Haar cascade from: " + cascadePath);
-        }
-        std::cout << "Haar cascade loaded successfully from: " << cascadePath << std::endl;
-        return true;
-    } catch (const cv::Exception& e) {
-        throw FaceDetectionException("OpenCV error loading cascade: " + std::string(e.what()));
-    }
+FACELIB_API Image createImage() {
+    return Image(new ImageData());
 }
 
-FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, double scaleFactor, int minNeighbors, int minSize) {
-    if (!image || image->mat.empty()) {
-        throw ImageProcessingException("Cannot detect faces in empty or null image");
-    }
+void ImageDeleter::operator()(ImageData* image) const {
+    deleteImage(image);
+}
+
+void FaceDetectorDeleter::operator()(FaceDetector* detector) const {
+    deleteFaceDetector(detector);
+}
 
-    if (!cascadeLoaded) {
-        throw FaceDetectionException("Haar cascade not loaded. Call loadHaarCascade() first.");
+static int channelsOf(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Gray8: return 1;
+        case PixelFormat::BGR8: return 3;
+        case PixelFormat::BGRA8: return 4;
     }
+    throw ImageProcessingException("Unknown pixel format");
+}
 
-    std::vector<FaceRect> result;
+FACELIB_API Image wrapImage(void* data, int width, int height, int stride, PixelFormat format) {
+    if (!data || width <= 0 || height <= 0) {
+        throw ImageProcessingException("Cannot wrap null or empty pixel buffer");
+    }
 
-    try {
-        // Convert to grayscale if needed
-        cv::Mat grayImage;
-        if (image->mat.channels() == 3) {
-            cv::cvtColor(image->mat, grayImage, cv::COLOR_BGR2GRAY);
-        } else {
-            grayImage = image->mat;
-        }
+    int channels = channelsOf(format);
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    if (stride == 0) {
+        stride = static_cast<int>(rowBytes);
+    } else if (stride < 0 || static_cast<size_t>(stride) < rowBytes) {
+        throw ImageProcessingException("Cannot wrap pixel buffer: stride " + std::to_string(stride) +
+                                       " is smaller than a row of " + std::to_string(rowBytes) + " bytes");
+    }
 
-        // Detect faces
-        std::vector<cv::Rect> faces;
-        faceCascade.detectMultiScale(
-            grayImage,
-            faces,
-            scaleFactor,
-            minNeighbors,
-            0,
-            cv::Size(minSize, minSize)
-        );
-
-        // Convert cv::Rect to FaceRect
-        for (const auto& face : faces) {
-            result.emplace_back(face.x, face.y, face.width, face.height);
-        }
+    // A cv::Mat over user data has no reference counter, so OpenCV never frees or reallocates it.
+    return Image(new ImageData(cv::Mat(height, width, CV_8UC(channels), data, static_cast<size_t>(stride)), true));
+}
 
-        std::cout << "Detected " << result.size() << " face(s)" << std::endl;
-        return result;
+FACELIB_API ImageView getImageView(const ImageData* image) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot view empty or null image");
+    }
+    if (image->mat.depth() != CV_8U) {
+        throw ImageProcessingException("Cannot view image with more than 8 bits per channel");
+    }
 
-    } catch (const cv::Exception& e) {
-        throw FaceDetectionException("OpenCV error during face detection: " + std::string(e.what()));
+    ImageView view;
+    switch (image->mat.channels()) {
+        case 1: view.format = PixelFormat::Gray8; break;
+        case 3: view.format = PixelFormat::BGR8; break;
+        case 4: view.format = PixelFormat::BGRA8; break;
+        default:
+            throw ImageProcessingException("Cannot view image with " + std::to_string(image->mat.channels()) + " channels");
     }
+    view.data = image->mat.data;
+    view.width = image->mat.cols;
+    view.height = image->mat.rows;
+    view.stride = static_cast<int>(image->mat.step[0]);
+    return view;
+}
+
+FACELIB_API Image cropToFace(const ImageData* image, const FaceRect& face, double padding) {
+    Image result = createImage();
+    cropToFace(image, face, padding, result.get());
+    return result;
 }
 
-FACELIB_API ImageData* cropToFace(const ImageData* image, const FaceRect& face, double padding) {
+FACELIB_API void cropToFace(const ImageData* image, const FaceRect& face, double padding, ImageData* output) {
     if (!image || image->mat.empty()) {
         throw ImageProcessingException("Cannot crop empty or null image");
     }
+    if (!output) {
+        throw ImageProcessingException("Cannot crop into null image");
+    }
 
     try {
         // Calculate padding
@@ -245,56 +228,37 @@ FACELIB_API ImageData* cropToFace(const ImageData* image, const FaceRect& face,
         // Create crop rectangle
         cv::Rect cropRect(cropX, cropY, cropWidth, cropHeight);
 
-        // Crop the image
-        cv::Mat croppedMat = image->mat(cropRect);
-
-        std::cout << "Cropped image to face region: " << cropWidth << "x" << cropHeight
-                  << " (padding: " << (padding * 100) << "%)" << std::endl;
+        // Crop the image. The crop is a view into the parent's pixels; it keeps them alive and is
+        // detached on first write.
+        output->share(image->mat(cropRect), image->borrowed);
 
-        return new ImageData(croppedMat);
+        FACELIB_LOG_INFO("Cropped image to face region: " << cropWidth << "x" << cropHeight
+                         << " (padding: " << (padding * 100) << "%)");
 
     } catch (const cv::Exception& e) {
         throw ImageProcessingException("OpenCV error during cropping: " + std::string(e.what()));
     }
 }
 
-FACELIB_API ImageData* cropToLargestFace(const ImageData* image, double padding) {
-    if (!image || image->mat.empty()) {
-        throw ImageProcessingException("Cannot crop empty or null image");
-    }
-
-    // Detect faces
-    std::vector<FaceRect> faces = detectFaces(image);
-
-    if (faces.empty()) {
-        throw FaceDetectionException("No faces detected in image");
-    }
-
-    // Find the largest face
-    FaceRect largestFace = faces[0];
-    int largestArea = largestFace.width * largestFace.height;
-
-    for (size_t i = 1; i < faces.size(); ++i) {
-        int area = faces[i].width * faces[i].height;
-        if (area > largestArea) {
-            largestArea = area;
-            largestFace = faces[i];
-        }
-    }
-
-    std::cout << "Using largest face of " << faces.size() << " detected faces" << std::endl;
-
-    return cropToFace(image, largestFace, padding);
+FACELIB_API Image drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces) {
+    Image result = createImage();
+    drawFaceRectangles(image, faces, result.get());
+    return result;
 }
 
-FACELIB_API ImageData* drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces) {
+FACELIB_API void drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces, ImageData* output) {
     if (!image || image->mat.empty()) {
         throw ImageProcessingException("Cannot draw on empty or null image");
     }
+    if (!output) {
+        throw ImageProcessingException("Cannot draw into null image");
+    }
 
     try {
-        // Create a copy of the image
-        cv::Mat resultMat = image->mat.clone();
+        // Draw on a copy of the image. The local reference keeps the source alive when output is the same image.
+        cv::Mat source = image->mat;
+        cv::Mat& resultMat = output->output();
+        source.copyTo(resultMat);
 
         // Draw rectangles around faces
         for (const auto& face : faces) {
@@ -311,28 +275,54 @@ FACELIB_API ImageData* drawFaceRectangles(const ImageData* image, const std::vec
                        1);
         }
 
-        std::cout << "Drew rectangles around " << faces.size() << " face(s)" << std::endl;
-
-        return new ImageData(resultMat);
+        FACELIB_LOG_INFO("Drew rectangles around " << faces.size() << " face(s)");
 
     } catch (const cv::Exception& e) {
         throw ImageProcessingException("OpenCV error while drawing rectangles: " + std::string(e.what()));
     }
 }
-FACELIB_API ImageData* convertToGrayscale(const ImageData* image) {
+
+// Returns image itself when it is already single-channel, otherwise converts it into scratch.
+// Alpha is dropped for 4-channel input.
+const cv::Mat& toGray(const cv::Mat& image, cv::Mat& scratch) {
+    switch (image.channels()) {
+        case 1:
+            return image;
+        case 3:
+            cv::cvtColor(image, scratch, cv::COLOR_BGR2GRAY);
+            return scratch;
+        case 4:
+            cv::cvtColor(image, scratch, cv::COLOR_BGRA2GRAY);
+            return scratch;
+        default:
+            throw ImageProcessingException("Cannot convert image with " + std::to_string(image.channels()) + " channels to grayscale");
+    }
+}
+
+FACELIB_API Image convertToGrayscale(const ImageData* image) {
+    Image result = createImage();
+    convertToGrayscale(image, result.get());
+    return result;
+}
+
+FACELIB_API void convertToGrayscale(const ImageData* image, ImageData* output) {
     if (!image || image->mat.empty()) {
         throw ImageProcessingException("Cannot convert empty or null image to grayscale");
     }
+    if (!output) {
+        throw ImageProcessingException("Cannot convert into null image");
+    }
 
     try {
-        cv::Mat grayImage;
-        if (image->mat.channels() == 3) {
-            cv::cvtColor(image->mat, grayImage, cv::COLOR_BGR2GRAY);
-        } else {
-            grayImage = image->mat.clone(); // Already grayscale or single channel
+        cv::Mat source = image->mat;
+        bool borrowed = image->borrowed;
+        if (source.channels() == 1) {
+            // Already grayscale - share the pixels
+            output->share(source, borrowed);
+            return;
         }
-        return new ImageData(grayImage);
+        toGray(source, output->output());
     } catch (const cv::Exception& e) {
         throw ImageProcessingException("OpenCV error during grayscale conversion: " + std::string(e.what()));
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,12 @@
 #ifndef FACELIB_H
 #define FACELIB_H
 
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -24,6 +30,19 @@
 
 // Forward Declaration to hide OpenCV Implementation.
 class ImageData;
+class FaceDetector;
+
+// Owning handles. Every function that creates an image or a detector returns one of these, so it is
+// released even when an exception unwinds the caller. Pass .get() to functions taking a pointer, or
+// .release() to manage the object manually with deleteImage() / deleteFaceDetector().
+struct FACELIB_API ImageDeleter {
+    void operator()(ImageData* image) const;
+};
+struct FACELIB_API FaceDetectorDeleter {
+    void operator()(FaceDetector* detector) const;
+};
+using Image = std::unique_ptr<ImageData, ImageDeleter>;
+using FaceDetectorHandle = std::unique_ptr<FaceDetector, FaceDetectorDeleter>;
 
 // Structure to hold face detection results.
 struct FACELIB_API FaceRect {
@@ -32,6 +51,18 @@ struct FACELIB_API FaceRect {
     FaceRect(int x_, int y_, int w_, int h_) : x(x_), y(y_), width(w_), height(h_) {}
 };
 
+// Pixel layouts that can be wrapped or exported without a copy. All are 8 bits per channel.
+enum class PixelFormat { Gray8, BGR8, BGRA8 };
+
+// Read-only view of an image's pixels. stride is the distance between rows in bytes.
+// Valid until the image it was taken from is deleted.
+struct FACELIB_API ImageView {
+    const unsigned char* data;
+    int width, height, stride;
+    PixelFormat format;
+    ImageView() : data(nullptr), width(0), height(0), stride(0), format(PixelFormat::Gray8) {}
+};
+
 // Custom exception classes for better error handling.
 class FACELIB_API FaceLibException : public std::runtime_error {
 public:
@@ -68,31 +99,530 @@ public:
         : FaceLibException("Face detection failed: "+message){}
 };
 
+// Logging. FaceLib does not write to std::cout; messages at or above the configured level go to the
+// installed sink. The level check is a single relaxed atomic load, and messages below the level are
+// never formatted. Trace messages are compiled in only when FACELIB_ENABLE_TRACE is defined.
+enum class LogLevel { Trace = 0, Debug, Info, Warning, Error, Off };
+
+class FACELIB_API LogSink {
+public:
+    virtual ~LogSink() = default;
+    // May be called concurrently from several threads.
+    virtual void write(LogLevel level, const std::string& message) = 0;
+};
+
+// Lock-free sink: write() copies the message into a fixed-size slot of a bounded ring buffer and never
+// blocks; messages that arrive while the ring is full are dropped and counted. Messages longer than a
+// slot are truncated. With a forwarding sink, a background thread drains the ring into it; otherwise
+// the owner calls drain().
+class FACELIB_API RingBufferLogSink : public LogSink {
+public:
+    explicit RingBufferLogSink(size_t capacity = 4096, std::shared_ptr<LogSink> forwardTo = nullptr);
+    ~RingBufferLogSink() override;
+
+    RingBufferLogSink(const RingBufferLogSink&) = delete;
+    RingBufferLogSink& operator=(const RingBufferLogSink&) = delete;
+
+    void write(LogLevel level, const std::string& message) override;
+
+    // Hands every pending message to consumer in arrival order and returns how many there were.
+    size_t drain(const std::function<void(LogLevel level, const std::string& message)>& consumer);
+    size_t droppedCount() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// Returns a sink that writes one line per message to stderr.
+FACELIB_API std::shared_ptr<LogSink> createConsoleLogSink();
+
+// The default configuration is a console sink at LogLevel::Warning. A null sink discards everything.
+FACELIB_API void setLogSink(std::shared_ptr<LogSink> sink);
+FACELIB_API void setLogLevel(LogLevel level);
+FACELIB_API LogLevel getLogLevel();
+
 // Image processing functions - without OpenCV types exposed.
-FACELIB_API ImageData* loadImageFromFile(const std::string& filename);
-FACELIB_API ImageData* loadImageFromBinary(const std::vector<unsigned char>& imageData);
+FACELIB_API Image loadImageFromFile(const std::string& filename);
+FACELIB_API Image loadImageFromBinary(const std::vector<unsigned char>& imageData);
+// Decodes an encoded image from any memory range, e.g. a MappedFile, without copying it first.
+FACELIB_API Image loadImageFromMemory(const void* data, size_t size);
+// Decodes straight to 8-bit grayscale. For JPEG only the luma component is reconstructed, skipping chroma
+// upsampling and colour conversion. detectFaces() runs on the result without any conversion.
+FACELIB_API Image loadImageGrayFromBinary(const std::vector<unsigned char>& imageData);
+FACELIB_API Image loadImageGrayFromMemory(const void* data, size_t size);
 FACELIB_API void displayImage(const ImageData* image, const std::string& windowName, int waitTime=0);
-FACELIB_API ImageData* convertToGrayscale(const ImageData* image);
+FACELIB_API Image convertToGrayscale(const ImageData* image);
 FACELIB_API void closeAllWindows();
 
 // Image manipulation functions.
 FACELIB_API std::vector<unsigned char> saveImageToBinary(const ImageData* image, const std::string& format = ".jpg");
 
+// Image encoders. An encoder fixes the format and its settings once, so encoding an image involves no
+// format lookup or parameter setup. The extension overloads also accept any other extension OpenCV can
+// write; such encoders have no settings. Encoders are immutable and can be shared by any number of threads.
+enum class ImageFormat {
+    JPEG,
+    PNG,
+    WebP
+};
+
+// Encode profiles, as JPEG quality / PNG zlib level and strategy / WebP quality:
+//   Default    95 with standard Huffman tables / 1, default strategy / 95 - what saveImageToBinary() uses
+//   Archive    95 with optimised Huffman tables and no chroma subsampling / 9, default strategy / 100
+//   Thumbnail  80 with standard Huffman tables / 6, filtered strategy / 80
+//   Fastest    75 with standard Huffman tables / 1, Huffman-only strategy / 75
+// Single-channel images, such as the grayscale face crops, are written as single-component JPEG, so
+// the chroma settings never apply to them and only Archive spends a second pass on Huffman tables.
+enum class EncodeProfile {
+    Default,
+    Archive,
+    Thumbnail,
+    Fastest
+};
+
+// Overrides of a profile's settings. -1 keeps the profile's value; settings a format does not have
+// are ignored.
+struct FACELIB_API EncodeOptions {
+    int quality = -1;           // JPEG 0-100, WebP 1-100, PNG zlib level 0-9
+    int optimizeHuffman = -1;   // JPEG: 1 computes image-specific Huffman tables in a second pass
+    int progressive = -1;       // JPEG: 1 writes a progressive file
+    int chromaSubsampling = -1; // JPEG colour images: 444, 422 or 420. Built against OpenCV
+                                // before 4.6 every JPEG is 4:2:0: 444 and 422 (including the
+                                // Archive profile's 444) log a warning once and are ignored
+    int pngStrategy = -1;       // PNG: a cv::ImwritePNGFlags strategy, 0-4
+};
+
+class ImageEncoder;
+struct FACELIB_API ImageEncoderDeleter {
+    void operator()(ImageEncoder* encoder) const;
+};
+using ImageEncoderHandle = std::unique_ptr<ImageEncoder, ImageEncoderDeleter>;
+
+FACELIB_API ImageEncoderHandle createImageEncoder(ImageFormat format, EncodeProfile profile,
+                                                  const EncodeOptions& overrides = EncodeOptions());
+FACELIB_API ImageEncoderHandle createImageEncoder(const std::string& extension, EncodeProfile profile,
+                                                  const EncodeOptions& overrides = EncodeOptions());
+// The Default profile with the given quality; -1 keeps the profile's.
+FACELIB_API ImageEncoderHandle createImageEncoder(ImageFormat format, int quality = -1);
+FACELIB_API ImageEncoderHandle createImageEncoder(const std::string& extension, int quality = -1);
+FACELIB_API void deleteImageEncoder(ImageEncoder* encoder);
+// Replaces the contents of output with the encoded image, reusing its capacity: a buffer kept per
+// worker stops allocating once it has grown to the largest image.
+FACELIB_API void encodeImage(const ImageEncoder* encoder, const ImageData* image, std::vector<unsigned char>& output);
+// The same with some of the encoder's settings overridden for this call only.
+FACELIB_API void encodeImage(const ImageEncoder* encoder, const ImageData* image, std::vector<unsigned char>& output,
+                             const EncodeOptions& overrides);
+// Encodes the images in parallel on the worker pool. outputs is resized to match and each entry is
+// reused as in encodeImage(), so passing the same outputs batch after batch recycles the buffers.
+FACELIB_API void encodeImagesBatch(const ImageEncoder* encoder, const std::vector<const ImageData*>& images,
+                                   std::vector<std::vector<unsigned char>>& outputs);
+// saveImageToBinary() with a profile and overrides instead of the Default profile.
+FACELIB_API std::vector<unsigned char> saveImageToBinary(const ImageData* image, const std::string& format, EncodeProfile profile,
+                                                         const EncodeOptions& overrides = EncodeOptions());
+
 // Image Utility Functions.
+// Images are copy-on-write: copyImage(), crops and grayscale conversions of single-channel images share
+// pixels with their source instead of copying them. A crop keeps its whole source buffer alive.
 FACELIB_API void getImageDimensions(const ImageData* image, int& width, int& height);
 FACELIB_API bool isImageEmpty(const ImageData* image);
-FACELIB_API ImageData* copyImage(const ImageData* source);
+FACELIB_API Image copyImage(const ImageData* source);
 FACELIB_API void deleteImage(ImageData* image);
 
+// Reusable outputs. These overloads write into an existing image instead of allocating a new one; its
+// pixel buffer is reused when it is not shared and already has the right size and type, so a worker
+// that recycles the same Image per frame stops allocating once sizes settle. output may be the same
+// image as the input.
+FACELIB_API Image createImage();
+FACELIB_API void loadImageFromBinary(const std::vector<unsigned char>& imageData, ImageData* output);
+FACELIB_API void loadImageFromMemory(const void* data, size_t size, ImageData* output);
+FACELIB_API void loadImageGrayFromMemory(const void* data, size_t size, ImageData* output);
+FACELIB_API void convertToGrayscale(const ImageData* image, ImageData* output);
+FACELIB_API void cropToFace(const ImageData* image, const FaceRect& face, double padding, ImageData* output);
+FACELIB_API void drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces, ImageData* output);
+
+// Pixel buffer pool. Image buffers allocated by FaceLib are recycled through per-thread caches and a
+// shared pool instead of going back to the system allocator. The limit caps the bytes held idle in
+// the pool (512 MiB by default); 0 disables pooling. hits and misses count pooled allocations that
+// were served from the pool and from the system allocator respectively.
+struct FACELIB_API BufferPoolStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t cachedBytes = 0;
+};
+
+FACELIB_API BufferPoolStats getBufferPoolStats();
+FACELIB_API void resetBufferPoolStats();
+FACELIB_API void setBufferPoolLimit(size_t maxCachedBytes);
+FACELIB_API void trimBufferPool();
+
+// Zero-copy interop with caller-owned pixel buffers.
+// wrapImage() creates a non-owning image over data; the buffer must outlive the image and any crop or
+// grayscale view derived from it.
+// A stride of 0 means rows are tightly packed. copyImage() of a wrapped image makes an owned copy.
+FACELIB_API Image wrapImage(void* data, int width, int height, int stride, PixelFormat format);
+FACELIB_API ImageView getImageView(const ImageData* image);
+
 // File I/O Functions.
 FACELIB_API std::vector<unsigned char> readImageFile(const std::string& filename);
 FACELIB_API void writeBinaryToFile(const std::vector<unsigned char>& binaryData, const std::string& filename);
 
+// Read-only memory mapping of a whole file, released when the object is destroyed. Move-only.
+class FACELIB_API MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Throws FileOperationException if the file cannot be opened or mapped. Empty files map to an empty span.
+    // The whole file is read ahead unless randomAccess is set, for large files read a piece at a time.
+    static MappedFile open(const std::string& filename, bool randomAccess = false);
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Maps filename read-only instead of copying it into memory. Pair with loadImageFromMemory() to decode
+// straight from the page cache.
+FACELIB_API MappedFile mapImageFile(const std::string& filename);
+
+// Asynchronous file output. A writer's background threads write whole files from a bounded queue, so
+// producers hand encoded bytes over without touching the disk and only block while the queue is full.
+// Each wake-up takes up to maxBatch queued files; under SyncPolicy::Batch their syncs, and those of the
+// directories they are in, are done together once the batch has been written. Every file is written
+// with a single open, write and close; its directory must already exist. Completion is reported
+// through a future or a callback. Callbacks run on a writer thread, so they should be quick.
+enum class SyncPolicy {
+    None,     // leave write-back to the operating system
+    Batch,    // sync each batch's files and their directories before reporting them complete
+    EachFile  // sync every file and its directory before reporting it complete
+};
+
+struct FACELIB_API FileWriterOptions {
+    int threads = 1;
+    size_t queueCapacity = 256; // files waiting to be written
+    size_t maxBatch = 64;       // files taken per wake-up
+    SyncPolicy sync = SyncPolicy::None;
+};
+
+// error is null when the file was written.
+using FileWriteCallback = std::function<void(const std::string& filename, std::exception_ptr error)>;
+
+class FileWriter;
+struct FACELIB_API FileWriterDeleter {
+    void operator()(FileWriter* writer) const;
+};
+using FileWriterHandle = std::unique_ptr<FileWriter, FileWriterDeleter>;
+
+FACELIB_API FileWriterHandle createFileWriter(const FileWriterOptions& options = FileWriterOptions());
+// Writes everything still queued, then stops the writer's threads.
+FACELIB_API void deleteFileWriter(FileWriter* writer);
+// Queues data to replace the contents of filename. data is taken by value so that encoded buffers can
+// be moved in. A failed write surfaces as FileOperationException from the future or in the callback.
+FACELIB_API std::future<void> writeFileAsync(FileWriter* writer, const std::string& filename, std::vector<unsigned char> data);
+FACELIB_API void writeFileAsync(FileWriter* writer, const std::string& filename, std::vector<unsigned char> data,
+                                FileWriteCallback onComplete);
+// Blocks until the queue is empty and no write is in progress, including files queued while waiting.
+FACELIB_API void flushFileWriter(FileWriter* writer);
+
+// Packed face archives. Instead of one small file per crop, an archive keeps the encoded crops back to
+// back in one data file (path) and a fixed-size record per crop in an index file (path + ".index"):
+// the crop's source id, its face rectangle and where its bytes are. Archives are append-only. Any
+// number of threads can append through one writer at once; each append reserves its byte range and
+// index record under a short lock and writes outside it, data before record, so a crash leaves no
+// record pointing at incomplete data. Records that were never completed are skipped when the archive
+// is read. Opening a writer on an existing archive appends to it.
+struct FACELIB_API ArchivedFace {
+    std::string sourceId;
+    FaceRect face;
+    uint64_t offset = 0; // of the encoded crop in the data file
+    size_t size = 0;
+};
+
+class FaceArchiveWriter;
+class FaceArchiveReader;
+struct FACELIB_API FaceArchiveWriterDeleter {
+    void operator()(FaceArchiveWriter* writer) const;
+};
+struct FACELIB_API FaceArchiveReaderDeleter {
+    void operator()(FaceArchiveReader* reader) const;
+};
+using FaceArchiveWriterHandle = std::unique_ptr<FaceArchiveWriter, FaceArchiveWriterDeleter>;
+using FaceArchiveReaderHandle = std::unique_ptr<FaceArchiveReader, FaceArchiveReaderDeleter>;
+
+// Creates the archive if it does not exist. Throws FileOperationException for files that are not archives.
+FACELIB_API FaceArchiveWriterHandle openFaceArchiveWriter(const std::string& path);
+FACELIB_API void deleteFaceArchiveWriter(FaceArchiveWriter* writer);
+FACELIB_API void appendFace(FaceArchiveWriter* writer, const std::string& sourceId, const FaceRect& face,
+                            const void* data, size_t size);
+FACELIB_API void appendFace(FaceArchiveWriter* writer, const std::string& sourceId, const FaceRect& face,
+                            const std::vector<unsigned char>& data);
+// Flushes both files to stable storage.
+FACELIB_API void syncFaceArchive(FaceArchiveWriter* writer);
+
+// A reader maps the archive as it was when opened, in append order; later appends are not seen.
+FACELIB_API FaceArchiveReaderHandle openFaceArchive(const std::string& path);
+FACELIB_API void deleteFaceArchiveReader(FaceArchiveReader* reader);
+FACELIB_API size_t getArchiveFaceCount(const FaceArchiveReader* reader);
+FACELIB_API ArchivedFace getArchivedFace(const FaceArchiveReader* reader, size_t index);
+// The encoded crop in the mapped data file, valid while the reader lives; decode it with
+// loadImageFromMemory(). Only the pages of crops that are read are loaded.
+FACELIB_API const unsigned char* getArchiveFaceData(const FaceArchiveReader* reader, size_t index, size_t& size);
+// Copies the encoded crop into output with a single positioned read, reusing output's capacity.
+FACELIB_API void readArchiveFace(const FaceArchiveReader* reader, size_t index, std::vector<unsigned char>& output);
+
 // Face detection functions.
+// loadHaarCascade() replaces the process-wide default detector used by the overloads without a FaceDetector.
+// It accepts any model createFaceDetector() does, picking the backend from the file.
+// Every detection call, context, tiled scan and pipeline throws FaceDetectionException unless
+// scaleFactor is greater than 1.
 FACELIB_API bool loadHaarCascade(const std::string& cascadePath);
 FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, double scaleFactor = 1.1, int minNeighbors = 3, int minSize=30);
-FACELIB_API ImageData* cropToFace(const ImageData* image, const FaceRect& face, double padding = 0.2);
-FACELIB_API ImageData* cropToLargestFace(const ImageData* image, double padding = 0.2);
-FACELIB_API ImageData* drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces);
+
+// Detector backends. Haar and LBP models are OpenCV cascade XML files (haarcascade_*.xml, lbpcascade_*.xml)
+// and run on cv::CascadeClassifier; LBP features are integer comparisons and evaluate several times faster
+// than Haar features, at some cost in accuracy. WaldBoost models are files written by
+// cv::xobjdetect::WBDetector and need FaceLib built with FACELIB_WITH_XOBJDETECT; the detector scans a
+// 24x24 window with a 4-pixel step and its own fixed scales, so scaleFactor and minNeighbors do not apply.
+// Auto picks the backend from the model file; any other value also checks that the file matches.
+enum class DetectorBackend {
+    Auto,
+    Haar,
+    LBP,
+    WaldBoost
+};
+
+FACELIB_API bool isDetectorBackendAvailable(DetectorBackend backend);
+
+// Compiles a Haar cascade XML file into FaceLib's binary cascade format (.flc). Binary cascades load
+// by mapping the file - no XML parsing - and the mapping is shared read-only by every process using
+// the same file. Pass them to loadHaarCascade(), createFaceDetector() or the ensemble loaders like any
+// cascade.
+// Only untilted Haar cascades in the opencv_traincascade format (such as the shipped
+// haarcascade_frontalface_alt.xml and _alt2.xml) can be compiled. Throws FaceDetectionException.
+FACELIB_API void compileCascade(const std::string& cascadePath, const std::string& outputPath);
+
+// FaceLib's cascade engine runs every untilted Haar cascade, from XML or compiled, evaluating several
+// windows at once with the widest instruction set the CPU supports (x86-64 builds with GCC or Clang,
+// except MinGW GCC, which only has the scalar evaluator); its faces match detectMultiScale's. LBP cascades stay on cv::CascadeClassifier. setSimdLevel()
+// selects another instruction set for the whole process, e.g. to compare them, and throws
+// FaceDetectionException for one the CPU or the build lacks.
+enum class SimdLevel {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+FACELIB_API bool isSimdLevelSupported(SimdLevel level);
+FACELIB_API void setSimdLevel(SimdLevel level);
+FACELIB_API SimdLevel getSimdLevel();
+
+// Face detector handles. A detector parses its model once and can be shared by any number of threads;
+// concurrent detectFaces() calls each run on their own classifier instance.
+FACELIB_API FaceDetectorHandle createFaceDetector(const std::string& modelPath, DetectorBackend backend = DetectorBackend::Auto);
+FACELIB_API DetectorBackend getDetectorBackend(const FaceDetector* detector);
+FACELIB_API void deleteFaceDetector(FaceDetector* detector);
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, double scaleFactor = 1.1, int minNeighbors = 3, int minSize=30);
+
+// Bounded detection. maxSize is the largest face side to look for (0 for no limit). maxLevels keeps only
+// that many pyramid levels, counted from the largest faces down (0 for all). maxFaces stops the scan
+// early: levels are scanned from the largest faces down, and once maxFaces faces are found only the
+// few further levels whose windows group directly with them are scanned; the maxFaces largest faces are
+// returned, largest first (0 scans everything). Their positions and sizes may differ slightly from a
+// full scan, as may which borderline faces pass minNeighbors. Setting maxLevels or maxFaces selects the per-level scan described
+// under the pyramid cache.
+struct FACELIB_API DetectOptions {
+    double scaleFactor = 1.1;
+    int minNeighbors = 3;
+    int minSize = 30;
+    int maxSize = 0;
+    int maxLevels = 0;
+    int maxFaces = 0;
+};
+
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const DetectOptions& options);
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const DetectOptions& options);
+
+// Detector contexts for video. A context is created for one frame size and reuses everything a frame
+// needs - grayscale conversion, the pyramid levels, integral images, hit lists - so once the first
+// frames have sized its buffers, detecting a Haar cascade on a frame does no heap allocation at all.
+// LBP cascades and ensembles work too but allocate as detectFaces() does; WaldBoost detectors are not
+// supported. Levels are resized with FaceLib's own bilinear filter rather than OpenCV's, which can
+// shift a borderline face by a pixel compared with detectFaces(). A context scans on the calling
+// thread and serves one thread at a time: give each worker its own. The detector must outlive it.
+// Frames must be 8-bit grayscale, BGR or BGRA at the context's size, else ImageProcessingException.
+class DetectorContext;
+struct FACELIB_API DetectorContextDeleter {
+    void operator()(DetectorContext* context) const;
+};
+using DetectorContextHandle = std::unique_ptr<DetectorContext, DetectorContextDeleter>;
+
+FACELIB_API DetectorContextHandle createDetectorContext(const FaceDetector* detector, int width, int height,
+                                                        const DetectOptions& options = DetectOptions());
+FACELIB_API void deleteDetectorContext(DetectorContext* context);
+// Replaces the contents of faces, reusing its capacity.
+FACELIB_API void detectFaces(DetectorContext* context, const ImageData* image, std::vector<FaceRect>& faces);
+
+// Region-restricted detection. Only the given regions, each grown by margin pixels on every side, are
+// scanned; regions that then overlap are merged so no area is scanned twice, and the regions run in
+// parallel on the worker pool. Only faces centred in one of the grown regions are returned, even where
+// a merged scan covered more. A mask is a single-channel 8-bit image of the same size where non-zero
+// pixels mark the area to scan; each connected area is scanned through its bounding box. Faces are
+// returned in full-image coordinates.
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const std::vector<FaceRect>& regions, int margin = 32,
+                                              double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30);
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const std::vector<FaceRect>& regions,
+                                              int margin = 32, double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30);
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const ImageData* mask, int margin = 32,
+                                              double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30);
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const ImageData* mask,
+                                              int margin = 32, double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30);
+
+// Cascade ensembles. A detector built from several Haar or LBP cascades (for example frontalface_alt and alt2) runs
+// all of them over one shared grayscale pyramid and merges their hits in a single detectFaces() call.
+// Union groups each cascade's hits on its own, as a single-cascade detector would, and then keeps the
+// best-supported of any faces from different cascades that overlap by more than overlapThreshold
+// (intersection over union). Pooled groups the raw hits of all cascades together, so minNeighbors
+// counts votes from every cascade. groupEps is the rectangle similarity used for grouping.
+enum class EnsembleMerge {
+    Union,
+    Pooled
+};
+
+struct FACELIB_API EnsembleOptions {
+    EnsembleMerge merge = EnsembleMerge::Union;
+    double groupEps = 0.2;
+    double overlapThreshold = 0.3;
+};
+
+FACELIB_API FaceDetectorHandle createEnsembleDetector(const std::vector<std::string>& cascadePaths,
+                                                      const EnsembleOptions& options = EnsembleOptions());
+// Replaces the process-wide default detector with an ensemble.
+FACELIB_API bool loadHaarCascades(const std::vector<std::string>& cascadePaths, const EnsembleOptions& options = EnsembleOptions());
+
+// Detection pyramid cache, off by default. Once enabled on an image, the first detection keeps its
+// grayscale conversion and scaled pyramid levels on the image; later detectFaces() calls - with another
+// detector, other minNeighbors or minSize, or through cropToLargestFace() - reuse every level of the same
+// size, so repeating a scaleFactor rebuilds nothing. At most 64 levels are kept, dropping the least
+// recently used. Batch and region detection never use the cache. Copies share the cache with their
+// source. Anything FaceLib writes into an image drops its cache; call notifyImageModified() after
+// changing the memory behind a wrapImage() image, or its detections return stale results.
+// Haar cascades on FaceLib's engine scan cached levels with detectMultiScale's own step rule. LBP and
+// other cascades left on cv::CascadeClassifier scan each cached level with a two-pixel step at every
+// scale, where detectMultiScale steps one pixel from scale 2 up, so their results at large face sizes
+// can differ slightly. Disabling the cache frees it.
+FACELIB_API void enablePyramidCache(ImageData* image, bool enable = true);
+FACELIB_API void notifyImageModified(ImageData* image);
+
+// Detection-oriented decoding. loadImageForDetection() decodes straight to grayscale, and for JPEG input
+// picks the largest codec-native reduction (1/2, 1/4 or 1/8, applied during the inverse DCT) at which a
+// face of minSize source pixels still covers the cascade window. decodeScale receives the reduction;
+// detect on the result with minSize / decodeScale and map the faces back with scaleFaceRects().
+// detectFacesInEncoded() does all of that and returns faces in full-resolution coordinates, so the
+// full image only needs decoding when a face is found and is about to be cropped.
+FACELIB_API Image loadImageForDetection(const void* data, size_t size, int minSize, int& decodeScale,
+                                        const FaceDetector* detector = nullptr);
+FACELIB_API std::vector<FaceRect> scaleFaceRects(const std::vector<FaceRect>& faces, int factor);
+FACELIB_API std::vector<FaceRect> detectFacesInEncoded(const void* data, size_t size, double scaleFactor = 1.1,
+                                                       int minNeighbors = 3, int minSize = 30);
+FACELIB_API std::vector<FaceRect> detectFacesInEncoded(const FaceDetector* detector, const void* data, size_t size,
+                                                       double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30);
+
+// Batch detection. Images are spread across the FaceLib worker pool and results are returned in input order.
+// If any image fails, the first failure in input order is rethrown once the whole batch has finished.
+FACELIB_API std::vector<std::vector<FaceRect>> detectFacesBatch(const std::vector<const ImageData*>& images, double scaleFactor = 1.1, int minNeighbors = 3, int minSize=30);
+FACELIB_API std::vector<std::vector<FaceRect>> detectFacesBatch(const FaceDetector* detector, const std::vector<const ImageData*>& images, double scaleFactor = 1.1, int minNeighbors = 3, int minSize=30);
+
+// Tiled detection for very large images. The frame is cut into tileSize x tileSize tiles, each extended
+// by overlap pixels on every side, and the tiles are scanned in parallel on the worker pool, so only one
+// tile's grayscale pixels and integral images per worker are alive instead of full-frame ones. The
+// 512-pixel default keeps those within a few MB of L2/L3 cache. Tiles look for faces of up to
+// 2 * overlap pixels, and all their hits are grouped together once, so a face on a seam is reported
+// once. Larger faces are found by one extra pass over the frame downscaled so they fit the cascade
+// window. Results approximate a whole-frame detectFaces(). Images no larger than a tile, and WaldBoost
+// detectors, are detected whole. tileSize and overlap must be positive, else FaceDetectionException.
+struct FACELIB_API TiledDetectOptions {
+    int tileSize = 512;
+    int overlap = 96;
+    double scaleFactor = 1.1;
+    int minNeighbors = 3;
+    int minSize = 30;
+};
+
+FACELIB_API std::vector<FaceRect> detectFacesTiled(const ImageData* image, const TiledDetectOptions& options = TiledDetectOptions());
+FACELIB_API std::vector<FaceRect> detectFacesTiled(const FaceDetector* detector, const ImageData* image,
+                                                   const TiledDetectOptions& options = TiledDetectOptions());
+
+// Worker pool configuration. threads is the total number of threads a batch call may use, including the caller;
+// 0 selects one per hardware thread.
+FACELIB_API void setWorkerThreadCount(int threads);
+FACELIB_API int getWorkerThreadCount();
+
+// Pipelined batch processing: read -> decode -> detect -> crop -> grayscale -> encode -> write.
+// Each stage has its own worker threads and hands work to the next through a bounded queue,
+// so disk I/O, decoding, detection and encoding overlap. A thread count of 0 picks a default from
+// the number of hardware threads.
+struct FACELIB_API PipelineOptions {
+    int readThreads = 2;
+    int decodeThreads = 0;     // Detection-oriented decode (see loadImageForDetection()).
+    int detectThreads = 0;
+    int cropThreads = 0;       // Full-resolution decode, largest-face crop and grayscale conversion.
+    int encodeThreads = 0;
+    int writeThreads = 2;      // Threads of the asynchronous file writer (see createFileWriter()).
+    size_t queueCapacity = 16; // Images in flight between two stages; bounds memory for decoded frames.
+
+    double scaleFactor = 1.1;
+    int minNeighbors = 3;
+    int minSize = 30;
+    double padding = 0.2;
+    std::string outputFormat = ".jpg";
+    EncodeProfile outputProfile = EncodeProfile::Default;
+    EncodeOptions outputOptions;
+    SyncPolicy outputSync = SyncPolicy::None;
+    // When set, crops are appended to this face archive (see openFaceArchiveWriter()) instead of being
+    // written as files under outputDir, with the input path relative to inputDir as their source id.
+    std::string archivePath;
+
+    bool recursive = true;
+    std::vector<std::string> extensions = {".jpg", ".jpeg", ".png", ".bmp", ".webp", ".tif", ".tiff"};
+
+    // Called from a worker thread for every image that could not be processed.
+    std::function<void(const std::string& inputPath, const std::string& error)> onError;
+};
+
+struct FACELIB_API PipelineStats {
+    size_t imagesFound = 0;
+    size_t facesSaved = 0;    // Images for which a face crop was written.
+    size_t noFaceImages = 0;
+    size_t failedImages = 0;
+    double elapsedSeconds = 0.0;
+};
+
+// Processes every image under inputDir and writes the grayscale crop of its largest face to the same
+// relative path under outputDir, with the extension replaced by options.outputFormat.
+// Uses the default detector from loadHaarCascade() when detector is null.
+FACELIB_API PipelineStats processFaceDirectory(const std::string& inputDir, const std::string& outputDir,
+                                               const PipelineOptions& options = PipelineOptions(),
+                                               const FaceDetector* detector = nullptr);
+FACELIB_API Image cropToFace(const ImageData* image, const FaceRect& face, double padding = 0.2);
+FACELIB_API Image cropToLargestFace(const ImageData* image, double padding = 0.2);
+// Crops to the largest of faces already detected on image, without running the cascade again.
+FACELIB_API Image cropToLargestFace(const ImageData* image, const std::vector<FaceRect>& faces, double padding = 0.2);
+// Runs the cascade once and returns both the detected faces and a crop of the largest one.
+// Returns null (with faces left empty) when no face is found.
+FACELIB_API Image detectAndCropLargest(const ImageData* image, std::vector<FaceRect>& faces, double scaleFactor = 1.1,
+                                       int minNeighbors = 3, int minSize = 30, double padding = 0.2);
+FACELIB_API Image detectAndCropLargest(const FaceDetector* detector, const ImageData* image, std::vector<FaceRect>& faces,
+                                       double scaleFactor = 1.1, int minNeighbors = 3, int minSize = 30, double padding = 0.2);
+FACELIB_API Image drawFaceRectangles(const ImageData* image, const std::vector<FaceRect>& faces);
 
 #endif //FACELIB_H
\ No newline at end of file
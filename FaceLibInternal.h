@@ -0,0 +1,342 @@
+#ifndef FACELIB_INTERNAL_H
+#define FACELIB_INTERNAL_H
+
+#include "FaceLib.h"
+#include "BufferPool.h"
+#include "NativeCascade.h"
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Internal types shared by the FaceLib translation units - not part of the public header.
+
+// Grayscale conversion and pyramid levels of one image, kept between detection calls. Levels are keyed
+// by their size, so detections with different detectors or parameters share every level they have in common.
+// At most maxLevels are kept; beyond that the least recently scanned ones are dropped.
+struct PyramidCache {
+    static constexpr size_t maxLevels = 64;
+
+    struct Level {
+        cv::Mat image;
+        uint64_t lastUse = 0;
+    };
+
+    std::mutex mutex;
+    cv::Mat gray;
+    std::map<std::pair<int, int>, Level> levels;
+    uint64_t uses = 0;  // detection calls served, stamped on the levels each one scans
+};
+
+// Internal class to wrap cv::Mat - hidden from header.
+// Pixels are copy-on-write: copies and crops share the reference-counted cv::Mat buffer, and anything
+// that modifies pixels goes through writable() or output(), which detach first if the buffer is shared.
+class ImageData {
+public:
+    cv::Mat mat;
+    bool borrowed = false; // mat points into caller memory from wrapImage() and has no reference count
+    bool pyramidCacheEnabled = false; // opted into with enablePyramidCache()
+
+    ImageData() = default;
+    explicit ImageData(const cv::Mat& image, bool borrowed = false) : mat(image), borrowed(borrowed) {}
+    // Caller memory may go away independently of this image, so only owned pixels are shared.
+    // The pyramid cache describes the pixel values, so a copy shares it either way.
+    ImageData(const ImageData& other)
+        : mat(other.borrowed ? other.mat.clone() : other.mat), pyramidCacheEnabled(other.pyramidCacheEnabled),
+          pyramid(other.sharedPyramid()) {}
+    ImageData& operator=(const ImageData& other) {
+        if (this != &other) {
+            mat = other.borrowed ? other.mat.clone() : other.mat;
+            borrowed = false;
+            pyramidCacheEnabled = other.pyramidCacheEnabled;
+            std::shared_ptr<PyramidCache> cache = other.sharedPyramid();
+            std::lock_guard<std::mutex> lock(pyramidMutex);
+            pyramid = std::move(cache);
+        }
+        return *this;
+    }
+
+    bool isShared() const {
+        return borrowed || !mat.u || mat.u->refcount > 1;
+    }
+
+    // Returns the pixels for in-place modification, detaching from any other image or view sharing them.
+    cv::Mat& writable() {
+        if (!mat.empty() && isShared()) {
+            mat = mat.clone();
+            borrowed = false;
+        }
+        dropPyramid();
+        return mat;
+    }
+
+    // Returns a cv::Mat to be overwritten as a whole. A private buffer is kept for OpenCV's create()
+    // to reuse; a shared or borrowed one is dropped so the new contents never show up elsewhere.
+    // New buffers come from the FaceLib buffer pool.
+    cv::Mat& output() {
+        if (isShared()) {
+            mat.release();
+            borrowed = false;
+        }
+        mat.allocator = getPooledMatAllocator();
+        dropPyramid();
+        return mat;
+    }
+
+    // Makes this image another view of pixels, as crops and single-channel grayscale conversions do.
+    void share(const cv::Mat& pixels, bool borrowedPixels) {
+        mat = pixels;
+        borrowed = borrowedPixels;
+        dropPyramid();
+    }
+
+    // Pyramid cache for detection, created on first use; null when caching is disabled for this image.
+    std::shared_ptr<PyramidCache> pyramidCache() const {
+        std::lock_guard<std::mutex> lock(pyramidMutex);
+        if (!pyramid && pyramidCacheEnabled) {
+            pyramid = std::make_shared<PyramidCache>();
+        }
+        return pyramid;
+    }
+
+    // Forgets the cached pyramid once the pixels have changed. Images that still share the old
+    // pixels keep the old cache.
+    void dropPyramid() {
+        std::lock_guard<std::mutex> lock(pyramidMutex);
+        pyramid.reset();
+    }
+
+private:
+    std::shared_ptr<PyramidCache> sharedPyramid() const {
+        std::lock_guard<std::mutex> lock(pyramidMutex);
+        return pyramid;
+    }
+
+    // Detection only needs a const image, so the cache is filled in lazily behind a lock.
+    mutable std::mutex pyramidMutex;
+    mutable std::shared_ptr<PyramidCache> pyramid;
+};
+
+// WaldBoost backend (WaldBoostDetector.cpp), a wrapper around cv::xobjdetect::WBDetector. Without
+// FACELIB_WITH_XOBJDETECT the model cannot be loaded and loadWaldBoostModel() throws.
+class WaldBoostModel;
+bool isWaldBoostModel(const cv::FileNode& node);
+std::shared_ptr<const WaldBoostModel> loadWaldBoostModel(const cv::FileNode& node, const std::string& path);
+cv::Size waldBoostWindowSize();
+std::vector<cv::Rect> detectWaldBoost(const WaldBoostModel& model, const cv::Mat& gray, int minSize);
+
+// Keeps faces in order of score, dropping any that overlap an already kept face by more than
+// threshold (intersection over union).
+std::vector<cv::Rect> suppressOverlaps(const std::vector<cv::Rect>& faces, const std::vector<double>& scores, double threshold);
+
+class FaceDetector;
+
+// Merges the raw, ungrouped hits of each of a detector's cascades into faces: grouped as
+// detectMultiScale does for a single cascade, and as set by the detector's EnsembleOptions for several.
+std::vector<cv::Rect> mergeCascadeHits(const FaceDetector& detector, std::vector<std::vector<cv::Rect>>& hits, int minNeighbors);
+
+// Internal face detector - hidden from header.
+// Each model file is parsed once into a cv::FileStorage. Cascade models (Haar and LBP) run on
+// cv::CascadeClassifier: every concurrent caller leases its own set of classifier instances (one per
+// cascade) built from the parsed trees, since detectMultiScale keeps per-call state inside the
+// classifier. Leased sets are returned to an idle list and reused. A WaldBoost model keeps no per-call
+// state and is shared by all callers. Haar cascades run on FaceLib's own engine instead, from a binary
+// cascade file mapped once or compiled in memory from the XML; they are shared read-only and their
+// slot in a classifier set is null.
+class FaceDetector {
+public:
+    using ClassifierSet = std::vector<std::unique_ptr<cv::CascadeClassifier>>;
+
+    // What a caller leases: one classifier per cascade and the native engine's buffers.
+    struct Instance {
+        ClassifierSet classifiers;
+        NativeScratch scratch;
+    };
+
+    FaceDetector(const std::vector<std::string>& modelPaths, const EnsembleOptions& options, DetectorBackend requested)
+        : options(options) {
+        if (modelPaths.empty()) {
+            throw FaceDetectionException("Face detector needs at least one model");
+        }
+        for (const auto& modelPath : modelPaths) {
+            cascades.emplace_back();
+            Cascade& cascade = cascades.back();
+            cascade.path = modelPath;
+            if (isNativeCascadeFile(modelPath)) {
+                cascade.native = loadNativeCascade(modelPath);
+                cascade.window = cascade.native->window;
+                continue;
+            }
+            cascade.storage.open(modelPath, cv::FileStorage::READ);
+            if (!cascade.storage.isOpened()) {
+                throw FaceDetectionException("Failed to load detector model from: " + modelPath);
+            }
+            cascade.native = tryCompileNativeCascade(cascade.storage.getFirstTopLevelNode(), modelPath);
+            if (cascade.native) {
+                cascade.window = cascade.native->window;
+                cascade.storage.release();
+            }
+        }
+
+        cv::FileNode model = cascades[0].storage.isOpened() ? cascades[0].storage.getFirstTopLevelNode() : cv::FileNode();
+        if (requested == DetectorBackend::WaldBoost || (requested == DetectorBackend::Auto && isWaldBoostModel(model))) {
+            if (cascades.size() > 1) {
+                throw FaceDetectionException("Ensembles can only combine Haar and LBP cascades");
+            }
+            waldboost = loadWaldBoostModel(model, cascades[0].path);
+            backend = DetectorBackend::WaldBoost;
+            window = waldBoostWindowSize();
+            cascades.clear();
+            return;
+        }
+
+        // Build the first set up front so a bad cascade fails here rather than on first use.
+        idle.push_back(createInstance());
+        const ClassifierSet& classifiers = idle.back()->classifiers;
+        for (size_t i = 0; i < cascades.size(); ++i) {
+            // Only Haar cascades run natively.
+            DetectorBackend found = cascades[i].native ? DetectorBackend::Haar : cascadeBackend(*classifiers[i], cascades[i].path);
+            if (requested != DetectorBackend::Auto && found != requested) {
+                throw FaceDetectionException("Model " + cascades[i].path + " does not match the requested detector backend");
+            }
+            if (i == 0) {
+                backend = found;
+            }
+            if (!cascades[i].native) {
+                cascades[i].window = classifiers[i]->getOriginalWindowSize();
+            }
+            window.width = std::max(window.width, cascades[i].window.width);
+            window.height = std::max(window.height, cascades[i].window.height);
+        }
+    }
+
+    explicit FaceDetector(const std::string& modelPath, DetectorBackend requested = DetectorBackend::Auto)
+        : FaceDetector(std::vector<std::string>{modelPath}, EnsembleOptions(), requested) {}
+
+    FaceDetector(const FaceDetector&) = delete;
+    FaceDetector& operator=(const FaceDetector&) = delete;
+
+    // Smallest object every cascade can detect, in pixels.
+    cv::Size windowSize() const { return window; }
+
+    size_t cascadeCount() const { return cascades.size(); }
+    const EnsembleOptions& ensembleOptions() const { return options; }
+    // Backend of the first model; ensembles may mix Haar and LBP cascades.
+    DetectorBackend detectorBackend() const { return backend; }
+    // Null unless the backend is WaldBoost.
+    const WaldBoostModel* waldBoostModel() const { return waldboost.get(); }
+    // Null unless cascade index was loaded from a binary cascade file.
+    const NativeCascade* nativeCascade(size_t index) const { return cascades[index].native.get(); }
+    bool hasNativeCascade() const {
+        return std::any_of(cascades.begin(), cascades.end(), [](const Cascade& cascade) { return cascade.native != nullptr; });
+    }
+    cv::Size cascadeWindow(size_t index) const { return cascades[index].window; }
+
+    // RAII lease on one classifier per cascade; returns them to the idle list on destruction.
+    // operator[] must not be used for a native cascade.
+    class Lease {
+    public:
+        explicit Lease(const FaceDetector& owner) : owner(owner), instance(owner.acquire()) {}
+        ~Lease() { owner.release(std::move(instance)); }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        size_t size() const { return instance ? instance->classifiers.size() : 0; }
+        cv::CascadeClassifier& operator[](size_t index) const { return *instance->classifiers[index]; }
+        NativeScratch& scratch() const { return instance->scratch; }
+        const FaceDetector& detector() const { return owner; }
+    private:
+        const FaceDetector& owner;
+        std::unique_ptr<Instance> instance;
+    };
+
+private:
+    struct Cascade {
+        std::string path;
+        cv::FileStorage storage;
+        std::shared_ptr<const NativeCascade> native;
+        cv::Size window;
+    };
+
+    static DetectorBackend cascadeBackend(const cv::CascadeClassifier& classifier, const std::string& path) {
+        // Values of OpenCV's internal cv::FeatureEvaluator::HAAR and LBP.
+        switch (classifier.getFeatureType()) {
+            case 0: return DetectorBackend::Haar;
+            case 1: return DetectorBackend::LBP;
+            default: throw FaceDetectionException("Unsupported cascade feature type in: " + path);
+        }
+    }
+
+    std::unique_ptr<Instance> createInstance() const {
+        auto instance = std::make_unique<Instance>();
+        for (const Cascade& cascade : cascades) {
+            if (cascade.native) {
+                instance->classifiers.push_back(nullptr);
+                continue;
+            }
+            auto classifier = std::make_unique<cv::CascadeClassifier>();
+            if (!classifier->read(cascade.storage.getFirstTopLevelNode()) || classifier->empty()) {
+                throw FaceDetectionException("Failed to load cascade from: " + cascade.path);
+            }
+            instance->classifiers.push_back(std::move(classifier));
+        }
+        return instance;
+    }
+
+    std::unique_ptr<Instance> acquire() const {
+        if (waldboost) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!idle.empty()) {
+            std::unique_ptr<Instance> instance = std::move(idle.back());
+            idle.pop_back();
+            return instance;
+        }
+        // Reading from the shared FileStorage is kept under the lock; it only happens
+        // until the pool has grown to the peak number of concurrent callers.
+        return createInstance();
+    }
+
+    void release(std::unique_ptr<Instance> instance) const {
+        if (!instance) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        idle.push_back(std::move(instance));
+    }
+
+    std::vector<Cascade> cascades;
+    EnsembleOptions options;
+    DetectorBackend backend = DetectorBackend::Haar;
+    std::shared_ptr<const WaldBoostModel> waldboost;
+    cv::Size window;
+    mutable std::mutex poolMutex;
+    mutable std::vector<std::unique_ptr<Instance>> idle;
+};
+
+// Scans one pyramid level - the grayscale image scaled down by factor - with one of the leased cascades
+// at exactly its window size, and appends the raw, ungrouped hits in image coordinates. Native cascades
+// run on scratch.
+void scanPyramidLevel(const FaceDetector::Lease& classifiers, size_t cascade, const cv::Mat& level, float factor,
+                      NativeScratch& scratch, std::vector<cv::Rect>& hits);
+
+// Throws FaceDetectionException unless scaleFactor is a number above 1: every pyramid loop grows the
+// window by it and would otherwise never end.
+void checkScaleFactor(double scaleFactor);
+
+// Process-wide default detector set by loadHaarCascade(); throws if none has been loaded.
+std::shared_ptr<const FaceDetector> getDefaultDetector();
+
+// Returns image itself when it is already single-channel, otherwise converts it into scratch.
+// Alpha is dropped for 4-channel input.
+const cv::Mat& toGray(const cv::Mat& image, cv::Mat& scratch);
+
+// Decodes data into output with the given cv::imread flags.
+void decodeInto(const void* data, size_t size, int flags, ImageData* output);
+
+#endif //FACELIB_INTERNAL_H
@@ -0,0 +1,43 @@
+#ifndef FACELIB_LOG_H
+#define FACELIB_LOG_H
+
+#include "FaceLib.h"
+#include <atomic>
+#include <sstream>
+
+// Internal logging front end - not part of the public header.
+namespace facelib_log {
+
+extern std::atomic<int> threshold;
+
+inline bool enabled(LogLevel level) {
+    return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed);
+}
+
+void write(LogLevel level, const std::string& message);
+
+} // namespace facelib_log
+
+// Streams expr into a message only when level is enabled, e.g. FACELIB_LOG_INFO("Detected " << n << " face(s)").
+#define FACELIB_LOG(level, expr)                                   \
+    do {                                                           \
+        if (facelib_log::enabled(level)) {                         \
+            std::ostringstream facelibLogStream;                   \
+            facelibLogStream << expr;                              \
+            facelib_log::write(level, facelibLogStream.str());     \
+        }                                                          \
+    } while (0)
+
+#define FACELIB_LOG_DEBUG(expr) FACELIB_LOG(LogLevel::Debug, expr)
+#define FACELIB_LOG_INFO(expr) FACELIB_LOG(LogLevel::Info, expr)
+#define FACELIB_LOG_WARNING(expr) FACELIB_LOG(LogLevel::Warning, expr)
+#define FACELIB_LOG_ERROR(expr) FACELIB_LOG(LogLevel::Error, expr)
+
+// Per-image and per-stage trace sites cost nothing unless the library is built with FACELIB_ENABLE_TRACE.
+#ifdef FACELIB_ENABLE_TRACE
+#define FACELIB_TRACE(expr) FACELIB_LOG(LogLevel::Trace, expr)
+#else
+#define FACELIB_TRACE(expr) do {} while (0)
+#endif
+
+#endif //FACELIB_LOG_H
@@ -0,0 +1,189 @@
+#include "FaceLibLog.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace facelib_log {
+
+std::atomic<int> threshold{static_cast<int>(LogLevel::Warning)};
+
+static std::shared_ptr<LogSink> currentSink = createConsoleLogSink();
+
+void write(LogLevel level, const std::string& message) {
+    std::shared_ptr<LogSink> sink = std::atomic_load(&currentSink);
+    if (sink) {
+        sink->write(level, message);
+    }
+}
+
+static const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace: return "trace";
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error: return "error";
+        default: return "";
+    }
+}
+
+} // namespace facelib_log
+
+namespace {
+
+class ConsoleLogSink : public LogSink {
+public:
+    void write(LogLevel level, const std::string& message) override {
+        // One fputs per message keeps lines from interleaving without a lock of our own.
+        std::string line = std::string("[FaceLib ") + facelib_log::levelName(level) + "] " + message + "\n";
+        std::fputs(line.c_str(), stderr);
+    }
+};
+
+} // namespace
+
+FACELIB_API std::shared_ptr<LogSink> createConsoleLogSink() {
+    return std::make_shared<ConsoleLogSink>();
+}
+
+FACELIB_API void setLogSink(std::shared_ptr<LogSink> sink) {
+    std::atomic_store(&facelib_log::currentSink, std::move(sink));
+}
+
+FACELIB_API void setLogLevel(LogLevel level) {
+    facelib_log::threshold.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+FACELIB_API LogLevel getLogLevel() {
+    return static_cast<LogLevel>(facelib_log::threshold.load(std::memory_order_relaxed));
+}
+
+// Bounded multi-producer ring (Vyukov's sequence-numbered slots). Producers claim a slot with one CAS on
+// the write cursor; a slot's sequence number tells producers and the consumer whether it is free or filled.
+struct RingBufferLogSink::Impl {
+    static constexpr size_t MessageBytes = 240;
+
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        LogLevel level = LogLevel::Info;
+        unsigned int length = 0;
+        std::array<char, MessageBytes> text{};
+    };
+
+    explicit Impl(size_t requested) {
+        size_t capacity = 2;
+        while (capacity < requested) {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        slots = std::unique_ptr<Slot[]>(new Slot[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(LogLevel level, const std::string& message) {
+        size_t position = writeCursor.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (writeCursor.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.level = level;
+                    slot.length = static_cast<unsigned int>(std::min(message.size(), MessageBytes));
+                    std::memcpy(slot.text.data(), message.data(), slot.length);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false; // Full.
+            } else {
+                position = writeCursor.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Single consumer; drain() callers are serialised by drainMutex.
+    size_t drain(const std::function<void(LogLevel, const std::string&)>& consumer) {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        size_t count = 0;
+        std::string message;
+        for (;;) {
+            Slot& slot = slots[readCursor & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != readCursor + 1) {
+                return count;
+            }
+            LogLevel level = slot.level;
+            message.assign(slot.text.data(), slot.length);
+            slot.sequence.store(readCursor + mask + 1, std::memory_order_release);
+            ++readCursor;
+            ++count;
+            consumer(level, message);
+        }
+    }
+
+    size_t mask = 0;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> writeCursor{0};
+    alignas(64) size_t readCursor = 0;
+    std::mutex drainMutex;
+    std::atomic<size_t> dropped{0};
+
+    // Background forwarding.
+    std::shared_ptr<LogSink> forwardTo;
+    std::thread forwarder;
+    std::mutex forwarderMutex;
+    std::condition_variable forwarderWake;
+    bool stopping = false;
+};
+
+RingBufferLogSink::RingBufferLogSink(size_t capacity, std::shared_ptr<LogSink> forwardTo) : impl(new Impl(capacity)) {
+    impl->forwardTo = std::move(forwardTo);
+    if (impl->forwardTo) {
+        Impl* state = impl.get();
+        impl->forwarder = std::thread([state] {
+            auto forward = [state](LogLevel level, const std::string& message) { state->forwardTo->write(level, message); };
+            std::unique_lock<std::mutex> lock(state->forwarderMutex);
+            while (!state->stopping) {
+                state->forwarderWake.wait_for(lock, std::chrono::milliseconds(20));
+                lock.unlock();
+                state->drain(forward);
+                lock.lock();
+            }
+            lock.unlock();
+            state->drain(forward);
+        });
+    }
+}
+
+RingBufferLogSink::~RingBufferLogSink() {
+    if (impl->forwarder.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(impl->forwarderMutex);
+            impl->stopping = true;
+        }
+        impl->forwarderWake.notify_all();
+        impl->forwarder.join();
+    }
+}
+
+void RingBufferLogSink::write(LogLevel level, const std::string& message) {
+    if (!impl->push(level, message)) {
+        impl->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t RingBufferLogSink::drain(const std::function<void(LogLevel level, const std::string& message)>& consumer) {
+    return impl->drain(consumer);
+}
+
+size_t RingBufferLogSink::droppedCount() const {
+    return impl->dropped.load(std::memory_order_relaxed);
+}
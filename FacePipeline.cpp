@@ -0,0 +1,316 @@
+#include "FaceLibInternal.h"
+#include "BoundedQueue.h"
+#include "FaceLibLog.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// One image travelling through the pipeline. Each stage fills in its output and clears its input,
+// so at most one representation of the image is held at a time.
+struct WorkItem {
+    std::string inputPath;
+    std::string outputPath;
+    MappedFile source;                 // Mapped input file, kept until the crop stage decodes it in full.
+    int decodeScale = 1;               // Reduction of the detection decode.
+    FaceRect face;                     // Largest face in full-resolution coordinates after detect.
+    std::vector<unsigned char> bytes;  // Encoded crop after encode.
+    Image image;                       // Reduced grayscale image after decode, grayscale crop after crop.
+};
+
+using WorkQueue = BoundedQueue<WorkItem>;
+
+int resolveThreads(int requested, unsigned int divisor) {
+    if (requested > 0) {
+        return requested;
+    }
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<int>(std::max(1u, hardware / divisor));
+}
+
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+class Pipeline {
+public:
+    Pipeline(const std::string& inputDir, const std::string& outputDir, const PipelineOptions& options, const FaceDetector* detector)
+        : inputRoot(inputDir), outputRoot(outputDir), options(options), detector(detector), encoder(createImageEncoder(options.outputFormat, options.outputProfile, options.outputOptions)),
+          pathQueue(options.queueCapacity), readQueue(options.queueCapacity), decodeQueue(options.queueCapacity),
+          detectQueue(options.queueCapacity), cropQueue(options.queueCapacity),
+          archive(options.archivePath.empty() ? nullptr : openFaceArchiveWriter(options.archivePath)), writer(createWriter(options)) {
+        for (const auto& extension : options.extensions) {
+            extensions.insert(toLower(extension));
+        }
+    }
+
+    PipelineStats run() {
+        auto start = std::chrono::steady_clock::now();
+
+        startStage(resolveThreads(options.readThreads, 4), pathQueue, &readQueue, &Pipeline::readStage);
+        startStage(resolveThreads(options.decodeThreads, 2), readQueue, &decodeQueue, &Pipeline::decodeStage);
+        startStage(resolveThreads(options.detectThreads, 1), decodeQueue, &detectQueue, &Pipeline::detectStage);
+        startStage(resolveThreads(options.cropThreads, 2), detectQueue, &cropQueue, &Pipeline::cropStage);
+        startStage(resolveThreads(options.encodeThreads, 4), cropQueue, nullptr, &Pipeline::encodeStage);
+
+        // The calling thread walks the directory tree and feeds the first stage, so paths are
+        // streamed rather than collected up front.
+        std::exception_ptr walkError;
+        try {
+            walk();
+        } catch (...) {
+            walkError = std::current_exception();
+        }
+        pathQueue.close();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (writer) {
+            flushFileWriter(writer.get());
+        }
+        if (archive && options.outputSync != SyncPolicy::None) {
+            syncFaceArchive(archive.get());
+        }
+
+        if (walkError) {
+            std::rethrow_exception(walkError);
+        }
+
+        FACELIB_LOG_INFO("Pipeline finished: " << facesSaved << " of " << imagesFound << " image(s) saved, "
+                         << noFaceImages << " without faces, " << failedImages << " failed");
+
+        PipelineStats stats;
+        stats.imagesFound = imagesFound;
+        stats.facesSaved = facesSaved;
+        stats.noFaceImages = noFaceImages;
+        stats.failedImages = failedImages;
+        stats.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+private:
+    using StageFunction = bool (Pipeline::*)(WorkItem&);
+
+    // Starts workerCount threads that move items from input through stage() into output.
+    // The last worker of a stage to finish closes the output queue.
+    void startStage(int workerCount, WorkQueue& input, WorkQueue* output, StageFunction stage) {
+        auto remaining = std::make_shared<std::atomic<int>>(workerCount);
+        for (int i = 0; i < workerCount; ++i) {
+            threads.emplace_back([this, &input, output, stage, remaining] {
+                WorkItem item;
+                while (input.pop(item)) {
+                    bool forward = false;
+                    try {
+                        forward = (this->*stage)(item);
+                        FACELIB_TRACE("Pipeline stage done for " << item.inputPath << (forward ? "" : " (dropped)"));
+                    } catch (const std::exception& e) {
+                        fail(item.inputPath, e.what());
+                    }
+                    if (forward && output) {
+                        output->push(std::move(item));
+                    }
+                }
+                if (remaining->fetch_sub(1) == 1 && output) {
+                    output->close();
+                }
+            });
+        }
+    }
+
+    void walk() {
+        if (!fs::is_directory(inputRoot)) {
+            throw FileOperationException("Input directory does not exist: " + inputRoot.string());
+        }
+
+        auto visit = [this](const fs::directory_entry& entry) {
+            if (!entry.is_regular_file() || extensions.count(toLower(entry.path().extension().string())) == 0) {
+                return;
+            }
+            WorkItem item;
+            item.inputPath = entry.path().string();
+            fs::path output = outputRoot / entry.path().lexically_relative(inputRoot);
+            output.replace_extension(options.outputFormat);
+            item.outputPath = output.string();
+            ++imagesFound;
+            pathQueue.push(std::move(item));
+        };
+
+        if (options.recursive) {
+            for (const auto& entry : fs::recursive_directory_iterator(inputRoot, fs::directory_options::skip_permission_denied)) {
+                visit(entry);
+            }
+        } else {
+            for (const auto& entry : fs::directory_iterator(inputRoot)) {
+                visit(entry);
+            }
+        }
+    }
+
+    // Maps the file and touches every page, so the disk reads happen on this stage's threads and the
+    // decoder later finds the whole file in memory.
+    bool readStage(WorkItem& item) {
+        item.source = mapImageFile(item.inputPath);
+        const size_t pageSize = 4096;
+        unsigned char checksum = 0;
+        for (size_t offset = 0; offset < item.source.size(); offset += pageSize) {
+            checksum ^= item.source.data()[offset];
+        }
+        volatile unsigned char sink = checksum;
+        (void)sink;
+        return true;
+    }
+
+    // Decodes only what detection needs: grayscale, and for JPEG at a reduced DCT scale.
+    bool decodeStage(WorkItem& item) {
+        item.image = loadImageForDetection(item.source.data(), item.source.size(), options.minSize, item.decodeScale, detector);
+        return true;
+    }
+
+    bool detectStage(WorkItem& item) {
+        // Only the largest face is cropped, so the scan stops once it has been found.
+        DetectOptions detectOptions;
+        detectOptions.scaleFactor = options.scaleFactor;
+        detectOptions.minNeighbors = options.minNeighbors;
+        detectOptions.minSize = options.minSize / item.decodeScale;
+        detectOptions.maxFaces = 1;
+        std::vector<FaceRect> faces = detector
+            ? detectFaces(detector, item.image.get(), detectOptions)
+            : detectFaces(item.image.get(), detectOptions);
+        item.image.reset();
+        if (faces.empty()) {
+            ++noFaceImages;
+            return false;
+        }
+
+        item.face = scaleFaceRects({faces.front()}, item.decodeScale).front();
+        return true;
+    }
+
+    // Full-resolution decode happens only for images that have a face to crop. Decoding straight to
+    // grayscale makes the crop a view and the grayscale conversion free.
+    bool cropStage(WorkItem& item) {
+        Image original = loadImageGrayFromMemory(item.source.data(), item.source.size());
+        item.source = MappedFile();
+        Image crop = cropToFace(original.get(), item.face, options.padding);
+        item.image = convertToGrayscale(crop.get());
+        return true;
+    }
+
+    // Hands the encoded crop to the file writer, whose threads do the disk writes; the face counts as
+    // saved once the write has completed. Archive appends are a single positioned write and happen here.
+    bool encodeStage(WorkItem& item) {
+        encodeImage(encoder.get(), item.image.get(), item.bytes);
+        item.image.reset();
+        if (archive) {
+            std::string sourceId = fs::path(item.inputPath).lexically_relative(inputRoot).generic_string();
+            appendFace(archive.get(), sourceId, item.face, item.bytes);
+            ++facesSaved;
+            return true;
+        }
+        ensureDirectory(fs::path(item.outputPath).parent_path());
+        std::string inputPath = item.inputPath;
+        writeFileAsync(writer.get(), item.outputPath, std::move(item.bytes),
+                       [this, inputPath](const std::string&, std::exception_ptr error) {
+                           if (!error) {
+                               ++facesSaved;
+                               return;
+                           }
+                           try {
+                               std::rethrow_exception(error);
+                           } catch (const std::exception& e) {
+                               fail(inputPath, e.what());
+                           }
+                       });
+        return true;
+    }
+
+    // Null when crops go to an archive, which needs no writer threads.
+    static FileWriterHandle createWriter(const PipelineOptions& options) {
+        if (!options.archivePath.empty()) {
+            return nullptr;
+        }
+        FileWriterOptions writerOptions;
+        writerOptions.threads = resolveThreads(options.writeThreads, 4);
+        writerOptions.queueCapacity = options.queueCapacity;
+        writerOptions.sync = options.outputSync;
+        return createFileWriter(writerOptions);
+    }
+
+    // Creates each output directory once instead of probing the filesystem for every file.
+    void ensureDirectory(const fs::path& directory) {
+        if (directory.empty()) {
+            return;
+        }
+        std::string key = directory.string();
+        {
+            std::lock_guard<std::mutex> lock(directoryMutex);
+            if (createdDirectories.count(key)) {
+                return;
+            }
+        }
+        fs::create_directories(directory);
+        std::lock_guard<std::mutex> lock(directoryMutex);
+        createdDirectories.insert(key);
+    }
+
+    void fail(const std::string& inputPath, const std::string& error) {
+        ++failedImages;
+        FACELIB_LOG_WARNING("Pipeline failed on " << inputPath << ": " << error);
+        if (options.onError) {
+            options.onError(inputPath, error);
+        }
+    }
+
+    fs::path inputRoot;
+    fs::path outputRoot;
+    const PipelineOptions& options;
+    const FaceDetector* detector;
+    ImageEncoderHandle encoder;  // Shared by the encode threads.
+    std::unordered_set<std::string> extensions;
+
+    WorkQueue pathQueue;
+    WorkQueue readQueue;
+    WorkQueue decodeQueue;
+    WorkQueue detectQueue;
+    WorkQueue cropQueue;
+    std::vector<std::thread> threads;
+
+    std::mutex directoryMutex;
+    std::unordered_set<std::string> createdDirectories;
+
+    std::atomic<size_t> imagesFound{0};
+    std::atomic<size_t> facesSaved{0};
+    std::atomic<size_t> noFaceImages{0};
+    std::atomic<size_t> failedImages{0};
+
+    FaceArchiveWriterHandle archive;
+
+    // Last, so it is destroyed first: its destructor finishes the queued writes, whose callbacks use
+    // the members above. Null when writing to an archive.
+    FileWriterHandle writer;
+};
+
+} // namespace
+
+FACELIB_API PipelineStats processFaceDirectory(const std::string& inputDir, const std::string& outputDir,
+                                               const PipelineOptions& options, const FaceDetector* detector) {
+    checkScaleFactor(options.scaleFactor);
+    try {
+        Pipeline pipeline(inputDir, outputDir, options, detector);
+        return pipeline.run();
+    } catch (const fs::filesystem_error& e) {
+        throw FileOperationException(inputDir + " - " + e.what());
+    }
+}
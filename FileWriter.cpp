@@ -0,0 +1,319 @@
+#include "FaceLib.h"
+#include "BoundedQueue.h"
+#include "FaceLibLog.h"
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// Thin wrappers over the platform's file calls; each throws FileOperationException on failure.
+#if defined(_WIN32)
+using FileHandle = HANDLE;
+const FileHandle invalidFile = INVALID_HANDLE_VALUE;
+
+FileHandle createFile(const std::string& filename) {
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw FileOperationException("Cannot create file: " + filename);
+    }
+    return file;
+}
+
+void writeAll(FileHandle file, const std::string& filename, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(file, data, chunk, &written, nullptr)) {
+            throw FileOperationException("Failed to write binary data to file: " + filename);
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+void syncFile(FileHandle file, const std::string& filename) {
+    if (!FlushFileBuffers(file)) {
+        throw FileOperationException("Failed to sync file: " + filename);
+    }
+}
+
+void closeFile(FileHandle file) {
+    CloseHandle(file);
+}
+
+// Windows makes a new file's directory entry durable along with the file.
+void syncDirectory(const std::string&) {}
+#else
+using FileHandle = int;
+const FileHandle invalidFile = -1;
+
+FileHandle createFile(const std::string& filename) {
+    int file = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (file < 0) {
+        throw FileOperationException("Cannot create file: " + filename);
+    }
+    return file;
+}
+
+void writeAll(FileHandle file, const std::string& filename, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(file, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw FileOperationException("Failed to write binary data to file: " + filename);
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void syncFile(FileHandle file, const std::string& filename) {
+    if (::fsync(file) != 0) {
+        throw FileOperationException("Failed to sync file: " + filename);
+    }
+}
+
+void closeFile(FileHandle file) {
+    ::close(file);
+}
+
+// A new file is only durable once the directory entry pointing at it is.
+void syncDirectory(const std::string& directory) {
+    int file = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (file < 0) {
+        throw FileOperationException("Cannot open directory: " + directory);
+    }
+    int result = ::fsync(file);
+    ::close(file);
+    if (result != 0) {
+        throw FileOperationException("Failed to sync directory: " + directory);
+    }
+}
+#endif
+
+std::string parentDirectory(const std::string& filename) {
+    std::string parent = std::filesystem::path(filename).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+struct FileWriteRequest {
+    std::string filename;
+    std::vector<unsigned char> data;
+    FileWriteCallback onComplete;
+};
+
+} // namespace
+
+FACELIB_API void writeBinaryToFile(const std::vector<unsigned char>& binaryData, const std::string& filename) {
+    FileHandle file = createFile(filename);
+    try {
+        writeAll(file, filename, binaryData.data(), binaryData.size());
+    } catch (...) {
+        closeFile(file);
+        throw;
+    }
+    closeFile(file);
+
+    FACELIB_LOG_INFO("Binary data written to file: " << filename);
+}
+
+class FileWriter {
+public:
+    explicit FileWriter(const FileWriterOptions& options)
+        : sync(options.sync), maxBatch(std::max<size_t>(1, options.maxBatch)), queue(options.queueCapacity) {
+        int threadCount = std::max(1, options.threads);
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~FileWriter() {
+        queue.close();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void submit(FileWriteRequest request) {
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            ++pending;
+        }
+        queue.push(std::move(request));  // only closed by the destructor
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(progressMutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    // Per-thread state for one batch, kept between batches so that its vectors stop allocating.
+    struct Batch {
+        std::vector<FileWriteRequest> requests;
+        std::vector<FileHandle> files;
+        std::vector<std::exception_ptr> errors;
+        std::vector<std::string> directories;
+    };
+
+    void run() {
+        Batch batch;
+        while (queue.popBatch(batch.requests, maxBatch)) {
+            writeBatch(batch);
+        }
+    }
+
+    void writeBatch(Batch& batch) {
+        const size_t count = batch.requests.size();
+        batch.files.assign(count, invalidFile);
+        batch.errors.assign(count, nullptr);
+
+        for (size_t i = 0; i < count; ++i) {
+            FileWriteRequest& request = batch.requests[i];
+            FileHandle& file = batch.files[i];
+            try {
+                file = createFile(request.filename);
+                writeAll(file, request.filename, request.data.data(), request.data.size());
+                if (sync == SyncPolicy::EachFile) {
+                    syncFile(file, request.filename);
+                    syncDirectory(parentDirectory(request.filename));
+                }
+            } catch (...) {
+                batch.errors[i] = std::current_exception();
+            }
+            if (sync != SyncPolicy::Batch || batch.errors[i]) {
+                if (file != invalidFile) {
+                    closeFile(file);
+                    file = invalidFile;
+                }
+                complete(request, batch.errors[i]);
+            }
+        }
+
+        if (sync != SyncPolicy::Batch) {
+            return;
+        }
+
+        // Sync the files in the order they were written, then each directory they were created in once.
+        batch.directories.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (batch.files[i] == invalidFile) {
+                continue;
+            }
+            try {
+                syncFile(batch.files[i], batch.requests[i].filename);
+            } catch (...) {
+                batch.errors[i] = std::current_exception();
+            }
+            closeFile(batch.files[i]);
+            std::string directory = parentDirectory(batch.requests[i].filename);
+            if (std::find(batch.directories.begin(), batch.directories.end(), directory) == batch.directories.end()) {
+                batch.directories.push_back(std::move(directory));
+            }
+        }
+        for (const auto& directory : batch.directories) {
+            std::exception_ptr error;
+            try {
+                syncDirectory(directory);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            for (size_t i = 0; i < count && error; ++i) {
+                if (batch.files[i] != invalidFile && !batch.errors[i] && parentDirectory(batch.requests[i].filename) == directory) {
+                    batch.errors[i] = error;
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (batch.files[i] != invalidFile) {
+                complete(batch.requests[i], batch.errors[i]);
+            }
+        }
+    }
+
+    void complete(FileWriteRequest& request, std::exception_ptr error) {
+        FACELIB_TRACE("File writer " << (error ? "failed on " : "wrote ") << request.filename << " (" << request.data.size() << " bytes)");
+        request.data = std::vector<unsigned char>();
+        if (request.onComplete) {
+            try {
+                request.onComplete(request.filename, error);
+            } catch (const std::exception& e) {
+                FACELIB_LOG_WARNING("File write callback for " << request.filename << " threw: " << e.what());
+            } catch (...) {
+                FACELIB_LOG_WARNING("File write callback for " << request.filename << " threw");
+            }
+        }
+        std::lock_guard<std::mutex> lock(progressMutex);
+        if (--pending == 0) {
+            idle.notify_all();
+        }
+    }
+
+    const SyncPolicy sync;
+    const size_t maxBatch;
+    BoundedQueue<FileWriteRequest> queue;
+    std::vector<std::thread> threads;
+
+    std::mutex progressMutex;
+    std::condition_variable idle;
+    size_t pending = 0;  // submitted and not yet completed
+};
+
+FACELIB_API FileWriterHandle createFileWriter(const FileWriterOptions& options) {
+    return FileWriterHandle(new FileWriter(options));
+}
+
+FACELIB_API void deleteFileWriter(FileWriter* writer) {
+    delete writer;
+}
+
+void FileWriterDeleter::operator()(FileWriter* writer) const {
+    deleteFileWriter(writer);
+}
+
+FACELIB_API std::future<void> writeFileAsync(FileWriter* writer, const std::string& filename, std::vector<unsigned char> data) {
+    auto promise = std::make_shared<std::promise<void>>();
+    std::future<void> result = promise->get_future();
+    writeFileAsync(writer, filename, std::move(data), [promise](const std::string&, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value();
+        }
+    });
+    return result;
+}
+
+FACELIB_API void writeFileAsync(FileWriter* writer, const std::string& filename, std::vector<unsigned char> data,
+                                FileWriteCallback onComplete) {
+    if (!writer) {
+        throw FileOperationException("File writer is null");
+    }
+    writer->submit(FileWriteRequest{filename, std::move(data), std::move(onComplete)});
+}
+
+FACELIB_API void flushFileWriter(FileWriter* writer) {
+    if (!writer) {
+        throw FileOperationException("File writer is null");
+    }
+    writer->flush();
+}
@@ -0,0 +1,321 @@
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
+#include "ThreadPool.h"
+#include <opencv2/imgcodecs.hpp>
+#include <cctype>
+#include <exception>
+#include <mutex>
+
+// Image encoders. The extension and the imencode parameters are worked out once when an encoder is
+// created; encoding an image then only hands them to OpenCV together with the caller's buffer.
+
+// OpenCV 4.6 added control over JPEG chroma subsampling.
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+#define FACELIB_JPEG_SAMPLING_FACTOR 1
+#endif
+
+class ImageEncoder {
+public:
+    std::string extension;
+    bool hasSettings = false;  // false for extensions other than JPEG, PNG and WebP
+    ImageFormat format = ImageFormat::JPEG;
+    EncodeOptions settings;    // the profile with the overrides applied; no field is -1
+    std::vector<int> params;
+};
+
+namespace {
+
+bool equalsIgnoreCase(const std::string& text, const char* lower) {
+    size_t i = 0;
+    for (; i < text.size() && lower[i]; ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != lower[i]) {
+            return false;
+        }
+    }
+    return i == text.size() && !lower[i];
+}
+
+// The format an extension names, or false for extensions without settings.
+bool parseFormat(const std::string& extension, ImageFormat& format) {
+    if (equalsIgnoreCase(extension, ".jpg") || equalsIgnoreCase(extension, ".jpeg")) {
+        format = ImageFormat::JPEG;
+    } else if (equalsIgnoreCase(extension, ".png")) {
+        format = ImageFormat::PNG;
+    } else if (equalsIgnoreCase(extension, ".webp")) {
+        format = ImageFormat::WebP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* formatExtension(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::JPEG: return ".jpg";
+        case ImageFormat::PNG: return ".png";
+        case ImageFormat::WebP: return ".webp";
+    }
+    return "";
+}
+
+// The settings table documented with EncodeProfile in FaceLib.h.
+EncodeOptions profileSettings(ImageFormat format, EncodeProfile profile) {
+    EncodeOptions settings;
+    settings.optimizeHuffman = 0;
+    settings.progressive = 0;
+    settings.chromaSubsampling = 420;
+    settings.pngStrategy = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
+    switch (profile) {
+        case EncodeProfile::Default:
+            settings.quality = format == ImageFormat::PNG ? 1 : 95;
+            break;
+        case EncodeProfile::Archive:
+            settings.quality = format == ImageFormat::PNG ? 9 : format == ImageFormat::JPEG ? 95 : 100;
+            settings.optimizeHuffman = 1;
+            settings.chromaSubsampling = 444;
+            break;
+        case EncodeProfile::Thumbnail:
+            settings.quality = format == ImageFormat::PNG ? 6 : 80;
+            settings.pngStrategy = cv::IMWRITE_PNG_STRATEGY_FILTERED;
+            break;
+        case EncodeProfile::Fastest:
+            settings.quality = format == ImageFormat::PNG ? 1 : 75;
+            settings.pngStrategy = cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY;
+            break;
+    }
+    return settings;
+}
+
+void applyOverrides(EncodeOptions& settings, const EncodeOptions& overrides) {
+    auto apply = [](int& value, int override) {
+        if (override >= 0) {
+            value = override;
+        }
+    };
+    apply(settings.quality, overrides.quality);
+    apply(settings.optimizeHuffman, overrides.optimizeHuffman);
+    apply(settings.progressive, overrides.progressive);
+    apply(settings.chromaSubsampling, overrides.chromaSubsampling);
+    apply(settings.pngStrategy, overrides.pngStrategy);
+}
+
+void checkRange(ImageFormat format, const char* setting, int value, int low, int high) {
+    if (value < low || value > high) {
+        throw ImageSaveException(std::string(formatExtension(format)) + " - " + setting + " must be in [" +
+                                 std::to_string(low) + ", " + std::to_string(high) + "]");
+    }
+}
+
+// Validates settings and writes the matching imencode parameters into params.
+void buildParams(ImageFormat format, const EncodeOptions& settings, std::vector<int>& params) {
+    params.clear();
+    switch (format) {
+        case ImageFormat::JPEG: {
+            checkRange(format, "quality", settings.quality, 0, 100);
+            checkRange(format, "optimizeHuffman", settings.optimizeHuffman, 0, 1);
+            checkRange(format, "progressive", settings.progressive, 0, 1);
+            params.insert(params.end(), {cv::IMWRITE_JPEG_QUALITY, settings.quality,
+                                         cv::IMWRITE_JPEG_OPTIMIZE, settings.optimizeHuffman,
+                                         cv::IMWRITE_JPEG_PROGRESSIVE, settings.progressive});
+            int sampling;
+            switch (settings.chromaSubsampling) {
+#ifdef FACELIB_JPEG_SAMPLING_FACTOR
+                case 444: sampling = cv::IMWRITE_JPEG_SAMPLING_FACTOR_444; break;
+                case 422: sampling = cv::IMWRITE_JPEG_SAMPLING_FACTOR_422; break;
+                case 420: sampling = cv::IMWRITE_JPEG_SAMPLING_FACTOR_420; break;
+#else
+                case 420: sampling = 0; break;
+                case 444: case 422: {
+                    // Older OpenCV has no sampling control and always writes 4:2:0; say so once.
+                    static std::once_flag warned;
+                    std::call_once(warned, [&] {
+                        FACELIB_LOG_WARNING(".jpg - chromaSubsampling " << settings.chromaSubsampling
+                                            << " needs OpenCV 4.6 or later; writing 4:2:0 instead");
+                    });
+                    sampling = 0;
+                    break;
+                }
+#endif
+                default: throw ImageSaveException(".jpg - chromaSubsampling must be 444, 422 or 420");
+            }
+#ifdef FACELIB_JPEG_SAMPLING_FACTOR
+            params.insert(params.end(), {cv::IMWRITE_JPEG_SAMPLING_FACTOR, sampling});
+#else
+            (void)sampling;
+#endif
+            break;
+        }
+        case ImageFormat::PNG:
+            checkRange(format, "compression level", settings.quality, 0, 9);
+            checkRange(format, "pngStrategy", settings.pngStrategy, cv::IMWRITE_PNG_STRATEGY_DEFAULT, cv::IMWRITE_PNG_STRATEGY_FIXED);
+            // The compression level resets the strategy, so the strategy has to come after it.
+            params.insert(params.end(), {cv::IMWRITE_PNG_COMPRESSION, settings.quality,
+                                         cv::IMWRITE_PNG_STRATEGY, settings.pngStrategy});
+            break;
+        case ImageFormat::WebP:
+            checkRange(format, "quality", settings.quality, 1, 100);
+            params.insert(params.end(), {cv::IMWRITE_WEBP_QUALITY, settings.quality});
+            break;
+    }
+}
+
+void configure(ImageEncoder& encoder, ImageFormat format, EncodeProfile profile, const EncodeOptions& overrides) {
+    encoder.extension = formatExtension(format);
+    encoder.hasSettings = true;
+    encoder.format = format;
+    encoder.settings = profileSettings(format, profile);
+    applyOverrides(encoder.settings, overrides);
+    buildParams(format, encoder.settings, encoder.params);
+}
+
+void encodeInto(const std::string& extension, const std::vector<int>& params, const ImageData* image,
+                std::vector<unsigned char>& output) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot save empty or null image");
+    }
+    try {
+        // imencode clears the buffer and appends to it, so its capacity carries over between calls.
+        if (!cv::imencode(extension, image->mat, output, params)) {
+            throw ImageSaveException(extension);
+        }
+    } catch (const cv::Exception& e) {
+        throw ImageSaveException(extension + " - OpenCV error: " + e.what());
+    }
+}
+
+} // namespace
+
+FACELIB_API ImageEncoderHandle createImageEncoder(ImageFormat format, EncodeProfile profile, const EncodeOptions& overrides) {
+    ImageEncoderHandle encoder(new ImageEncoder());
+    configure(*encoder, format, profile, overrides);
+    return encoder;
+}
+
+FACELIB_API ImageEncoderHandle createImageEncoder(const std::string& extension, EncodeProfile profile, const EncodeOptions& overrides) {
+    ImageFormat format;
+    if (parseFormat(extension, format)) {
+        return createImageEncoder(format, profile, overrides);
+    }
+    if (!cv::haveImageWriter(extension)) {
+        throw ImageSaveException(extension);
+    }
+    ImageEncoderHandle encoder(new ImageEncoder());
+    encoder->extension = extension;
+    return encoder;
+}
+
+FACELIB_API ImageEncoderHandle createImageEncoder(ImageFormat format, int quality) {
+    EncodeOptions overrides;
+    overrides.quality = quality;
+    return createImageEncoder(format, EncodeProfile::Default, overrides);
+}
+
+FACELIB_API ImageEncoderHandle createImageEncoder(const std::string& extension, int quality) {
+    EncodeOptions overrides;
+    overrides.quality = quality;
+    return createImageEncoder(extension, EncodeProfile::Default, overrides);
+}
+
+FACELIB_API void deleteImageEncoder(ImageEncoder* encoder) {
+    delete encoder;
+}
+
+void ImageEncoderDeleter::operator()(ImageEncoder* encoder) const {
+    deleteImageEncoder(encoder);
+}
+
+FACELIB_API void encodeImage(const ImageEncoder* encoder, const ImageData* image, std::vector<unsigned char>& output) {
+    if (!encoder) {
+        throw ImageProcessingException("Image encoder is null");
+    }
+    encodeInto(encoder->extension, encoder->params, image, output);
+    FACELIB_TRACE("Encoded image as " << encoder->extension << ": " << output.size() << " bytes");
+}
+
+FACELIB_API void encodeImage(const ImageEncoder* encoder, const ImageData* image, std::vector<unsigned char>& output,
+                             const EncodeOptions& overrides) {
+    if (!encoder) {
+        throw ImageProcessingException("Image encoder is null");
+    }
+    if (!encoder->hasSettings) {
+        encodeImage(encoder, image, output);
+        return;
+    }
+
+    // The parameters are rebuilt in a per-thread vector, so overriding allocates nothing either.
+    thread_local std::vector<int> params;
+    EncodeOptions settings = encoder->settings;
+    applyOverrides(settings, overrides);
+    buildParams(encoder->format, settings, params);
+    encodeInto(encoder->extension, params, image, output);
+    FACELIB_TRACE("Encoded image as " << encoder->extension << " with overrides: " << output.size() << " bytes");
+}
+
+FACELIB_API void encodeImagesBatch(const ImageEncoder* encoder, const std::vector<const ImageData*>& images,
+                                   std::vector<std::vector<unsigned char>>& outputs) {
+    if (!encoder) {
+        throw ImageProcessingException("Image encoder is null");
+    }
+
+    outputs.resize(images.size());
+    std::vector<std::exception_ptr> errors(images.size());
+
+    getSharedThreadPool()->parallelFor(images.size(), [&](size_t index, size_t) {
+        try {
+            encodeInto(encoder->extension, encoder->params, images[index], outputs[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    FACELIB_LOG_INFO("Encoded batch of " << images.size() << " image(s) as " << encoder->extension);
+}
+
+namespace {
+
+std::vector<unsigned char> encodeToVector(const ImageEncoder& encoder, const ImageData* image, const std::string& format) {
+    // imencode grows its output as it goes; encoding into a per-thread scratch buffer that keeps its
+    // capacity between calls leaves one exact-size allocation for the result. Callers that keep their
+    // own buffer can use encodeImage() and skip that too.
+    thread_local std::vector<unsigned char> encodeBuffer;
+    encodeInto(encoder.extension, encoder.params, image, encodeBuffer);
+
+    FACELIB_LOG_INFO("Image saved to binary format " << format << ". Size: " << encodeBuffer.size() << " bytes");
+    return std::vector<unsigned char>(encodeBuffer.begin(), encodeBuffer.end());
+}
+
+} // namespace
+
+FACELIB_API std::vector<unsigned char> saveImageToBinary(const ImageData* image, const std::string& format) {
+    // The usual formats go through encoders built once per process; other extensions are passed to
+    // imencode as they are.
+    static const ImageEncoderHandle jpegEncoder = createImageEncoder(ImageFormat::JPEG);
+    static const ImageEncoderHandle pngEncoder = createImageEncoder(ImageFormat::PNG);
+    static const ImageEncoderHandle webpEncoder = createImageEncoder(ImageFormat::WebP);
+
+    ImageFormat parsed;
+    if (parseFormat(format, parsed)) {
+        const ImageEncoder* encoder = parsed == ImageFormat::JPEG ? jpegEncoder.get() : parsed == ImageFormat::PNG ? pngEncoder.get() : webpEncoder.get();
+        return encodeToVector(*encoder, image, format);
+    }
+    ImageEncoder generic;
+    generic.extension = format;
+    return encodeToVector(generic, image, format);
+}
+
+FACELIB_API std::vector<unsigned char> saveImageToBinary(const ImageData* image, const std::string& format, EncodeProfile profile,
+                                                         const EncodeOptions& overrides) {
+    ImageFormat parsed;
+    if (!parseFormat(format, parsed)) {
+        return saveImageToBinary(image, format);
+    }
+    ImageEncoder encoder;
+    configure(encoder, parsed, profile, overrides);
+    return encodeToVector(encoder, image, format);
+}
@@ -0,0 +1,118 @@
+#include "FaceLib.h"
+#include "FaceLibLog.h"
+#include <utility>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    if (!bytes) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(bytes);
+#else
+    munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        MappedFile released(std::move(*this));
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+MappedFile MappedFile::open(const std::string& filename, bool randomAccess) {
+    MappedFile mapped;
+
+#if defined(_WIN32)
+    // Random-access files may be archives that a writer is still appending to.
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, randomAccess ? FILE_SHARE_READ | FILE_SHARE_WRITE : FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | (randomAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN), nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw FileOperationException("Cannot open file: " + filename);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw FileOperationException("Failed to read file: " + filename);
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file); // Zero-length files cannot be mapped; an empty span is the honest result.
+        return mapped;
+    }
+
+    // The view stays valid after both handles are closed.
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        throw FileOperationException("Failed to map file: " + filename);
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        throw FileOperationException("Failed to map file: " + filename);
+    }
+    mapped.bytes = static_cast<const unsigned char*>(view);
+    mapped.length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw FileOperationException("Cannot open file: " + filename);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw FileOperationException("Failed to read file: " + filename);
+    }
+    if (info.st_size == 0) {
+        ::close(fd); // Zero-length files cannot be mapped; an empty span is the honest result.
+        return mapped;
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    size_t length = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        throw FileOperationException("Failed to map file: " + filename);
+    }
+    if (randomAccess) {
+        madvise(view, length, MADV_RANDOM);
+    } else {
+        // Decoders read front to back; ask for aggressive read-ahead.
+        madvise(view, length, MADV_SEQUENTIAL);
+        madvise(view, length, MADV_WILLNEED);
+    }
+    mapped.bytes = static_cast<const unsigned char*>(view);
+    mapped.length = length;
+#endif
+
+    FACELIB_TRACE("Mapped " << mapped.length << " bytes from " << filename);
+    return mapped;
+}
+
+FACELIB_API MappedFile mapImageFile(const std::string& filename) {
+    return MappedFile::open(filename);
+}
@@ -0,0 +1,564 @@
+#include "NativeCascade.h"
+#include "FaceLibLog.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+// "\r\n" in the magic catches files mangled by text-mode transfers.
+static const char cascadeMagic[8] = {'F', 'L', 'C', 'A', 'S', 'C', '\r', '\n'};
+static const uint32_t cascadeVersion = 1;
+static const uint32_t cascadeByteOrder = 0x01020304;
+static const size_t sectionAlignment = 64;
+
+// OpenCV lowers every stage threshold by this much when it reads a cascade.
+static const float stageThresholdEpsilon = 1e-5f;
+
+static FaceDetectionException cascadeError(const std::string& path, const std::string& reason) {
+    return FaceDetectionException("Invalid cascade " + path + ": " + reason);
+}
+
+// Number of elements in a section, given the header counts.
+static uint64_t sectionLength(const NativeCascadeHeader& header, int section) {
+    switch (section) {
+        case NativeCascadeHeader::StageThreshold:
+        case NativeCascadeHeader::StageTreeCount:
+            return header.stageCount;
+        case NativeCascadeHeader::TreeNodeCount:
+            return header.treeCount;
+        case NativeCascadeHeader::LeafValue:
+            return header.leafCount;
+        case NativeCascadeHeader::RectX:
+        case NativeCascadeHeader::RectY:
+        case NativeCascadeHeader::RectW:
+        case NativeCascadeHeader::RectH:
+        case NativeCascadeHeader::RectWeight:
+            return 3ull * header.featureCount;
+        default:
+            return header.nodeCount;
+    }
+}
+
+template <typename T>
+static void appendSection(std::vector<unsigned char>& bytes, NativeCascadeHeader& header, int section, const std::vector<T>& values) {
+    bytes.resize((bytes.size() + sectionAlignment - 1) / sectionAlignment * sectionAlignment, 0);
+    header.sectionOffset[section] = bytes.size();
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(values.data());
+    bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+}
+
+std::vector<unsigned char> compileNativeCascade(const cv::FileNode& cascade, const std::string& path) {
+    if (!cascade.isMap() || cascade["stageType"].empty()) {
+        throw cascadeError(path, "only cascades in the opencv_traincascade format can be compiled");
+    }
+    if (static_cast<std::string>(cascade["stageType"]) != "BOOST" || static_cast<std::string>(cascade["featureType"]) != "HAAR") {
+        throw cascadeError(path, "only boosted Haar cascades can be compiled");
+    }
+    if (static_cast<int>(cascade["featureParams"]["maxCatCount"]) > 0) {
+        throw cascadeError(path, "categorical features are not supported");
+    }
+
+    std::vector<float> stageThreshold, nodeThreshold, leafValue, rectWeight;
+    std::vector<uint32_t> stageTreeCount, treeNodeCount, nodeFeature;
+    std::vector<int32_t> nodeLeft, nodeRight;
+    for (cv::FileNode stage : cascade["stages"]) {
+        cv::FileNode weaks = stage["weakClassifiers"];
+        stageThreshold.push_back(static_cast<float>(static_cast<double>(stage["stageThreshold"])) - stageThresholdEpsilon);
+        stageTreeCount.push_back(static_cast<uint32_t>(weaks.size()));
+        for (cv::FileNode weak : weaks) {
+            cv::FileNode internalNodes = weak["internalNodes"];
+            cv::FileNode leafValues = weak["leafValues"];
+            size_t nodes = internalNodes.size() / 4;
+            if (nodes == 0 || internalNodes.size() % 4 != 0 || leafValues.size() != nodes + 1) {
+                throw cascadeError(path, "malformed weak classifier");
+            }
+            treeNodeCount.push_back(static_cast<uint32_t>(nodes));
+            cv::FileNodeIterator value = internalNodes.begin();
+            for (size_t i = 0; i < nodes; ++i) {
+                nodeLeft.push_back(static_cast<int>(*value++));
+                nodeRight.push_back(static_cast<int>(*value++));
+                nodeFeature.push_back(static_cast<uint32_t>(static_cast<int>(*value++)));
+                nodeThreshold.push_back(static_cast<float>(static_cast<double>(*value++)));
+            }
+            for (cv::FileNode leaf : leafValues) {
+                leafValue.push_back(static_cast<float>(static_cast<double>(leaf)));
+            }
+        }
+    }
+
+    cv::FileNode features = cascade["features"];
+    size_t featureCount = features.size();
+    std::vector<int32_t> rectX(3 * featureCount, 0), rectY(3 * featureCount, 0), rectW(3 * featureCount, 0), rectH(3 * featureCount, 0);
+    rectWeight.assign(3 * featureCount, 0.0f);
+    size_t f = 0;
+    for (cv::FileNode feature : features) {
+        if (!feature["tilted"].empty() && static_cast<int>(feature["tilted"]) != 0) {
+            throw cascadeError(path, "tilted Haar features are not supported");
+        }
+        cv::FileNode rects = feature["rects"];
+        if (rects.size() < 2 || rects.size() > 3) {
+            throw cascadeError(path, "Haar features need two or three rectangles");
+        }
+        size_t k = 0;
+        for (cv::FileNode rect : rects) {
+            cv::FileNodeIterator value = rect.begin();
+            size_t index = k * featureCount + f;
+            rectX[index] = static_cast<int>(*value++);
+            rectY[index] = static_cast<int>(*value++);
+            rectW[index] = static_cast<int>(*value++);
+            rectH[index] = static_cast<int>(*value++);
+            rectWeight[index] = static_cast<float>(static_cast<double>(*value++));
+            ++k;
+        }
+        ++f;
+    }
+
+    NativeCascadeHeader header = {};
+    std::memcpy(header.magic, cascadeMagic, sizeof(cascadeMagic));
+    header.version = cascadeVersion;
+    header.byteOrder = cascadeByteOrder;
+    header.windowWidth = static_cast<uint32_t>(static_cast<int>(cascade["width"]));
+    header.windowHeight = static_cast<uint32_t>(static_cast<int>(cascade["height"]));
+    header.stageCount = static_cast<uint32_t>(stageThreshold.size());
+    header.treeCount = static_cast<uint32_t>(treeNodeCount.size());
+    header.nodeCount = static_cast<uint32_t>(nodeThreshold.size());
+    header.leafCount = static_cast<uint32_t>(leafValue.size());
+    header.featureCount = static_cast<uint32_t>(featureCount);
+
+    std::vector<unsigned char> bytes(sizeof(header));
+    appendSection(bytes, header, NativeCascadeHeader::StageThreshold, stageThreshold);
+    appendSection(bytes, header, NativeCascadeHeader::StageTreeCount, stageTreeCount);
+    appendSection(bytes, header, NativeCascadeHeader::TreeNodeCount, treeNodeCount);
+    appendSection(bytes, header, NativeCascadeHeader::NodeLeft, nodeLeft);
+    appendSection(bytes, header, NativeCascadeHeader::NodeRight, nodeRight);
+    appendSection(bytes, header, NativeCascadeHeader::NodeFeature, nodeFeature);
+    appendSection(bytes, header, NativeCascadeHeader::NodeThreshold, nodeThreshold);
+    appendSection(bytes, header, NativeCascadeHeader::LeafValue, leafValue);
+    appendSection(bytes, header, NativeCascadeHeader::RectX, rectX);
+    appendSection(bytes, header, NativeCascadeHeader::RectY, rectY);
+    appendSection(bytes, header, NativeCascadeHeader::RectW, rectW);
+    appendSection(bytes, header, NativeCascadeHeader::RectH, rectH);
+    appendSection(bytes, header, NativeCascadeHeader::RectWeight, rectWeight);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+// Checks everything the evaluator relies on, so a damaged or hostile file cannot make it read out of bounds.
+static void validate(const NativeCascade& cascade, const std::string& path) {
+    if (cascade.window.width < 3 || cascade.window.height < 3 || cascade.stageCount == 0) {
+        throw cascadeError(path, "empty cascade");
+    }
+
+    uint64_t trees = 0;
+    for (uint32_t s = 0; s < cascade.stageCount; ++s) {
+        trees += cascade.stageTreeCount[s];
+    }
+    if (trees != cascade.treeCount) {
+        throw cascadeError(path, "stage tree counts do not add up");
+    }
+
+    uint64_t nodeStart = 0;
+    uint64_t leafStart = 0;
+    for (uint32_t t = 0; t < cascade.treeCount; ++t) {
+        int32_t nodes = static_cast<int32_t>(cascade.treeNodeCount[t]);
+        if (nodes <= 0 || nodeStart + nodes > cascade.nodeCount || leafStart + nodes + 1 > cascade.leafCount) {
+            throw cascadeError(path, "tree exceeds the node or leaf arrays");
+        }
+        for (int32_t n = 0; n < nodes; ++n) {
+            uint64_t node = nodeStart + n;
+            for (int32_t child : {cascade.nodeLeft[node], cascade.nodeRight[node]}) {
+                // Children must point forward to stay acyclic, or name one of the tree's leaves.
+                if (child == INT32_MIN || (child > 0 && (child <= n || child >= nodes)) || (child <= 0 && -child > nodes)) {
+                    throw cascadeError(path, "tree node points outside its tree");
+                }
+            }
+            if (cascade.nodeFeature[node] >= cascade.featureCount) {
+                throw cascadeError(path, "node refers to a missing feature");
+            }
+        }
+        nodeStart += nodes;
+        leafStart += nodes + 1;
+    }
+    if (nodeStart != cascade.nodeCount || leafStart != cascade.leafCount) {
+        throw cascadeError(path, "tree node counts do not add up");
+    }
+
+    // The evaluators always read the first two rectangles of a feature and the third unless its weight
+    // is 0, which is also when prepareOffsets() leaves it out.
+    for (uint64_t i = 0; i < 3ull * cascade.featureCount; ++i) {
+        if (i >= 2ull * cascade.featureCount && cascade.rectWeight[i] == 0.0f) {
+            continue;
+        }
+        int64_t x = cascade.rectX[i];
+        int64_t y = cascade.rectY[i];
+        int64_t width = cascade.rectW[i];
+        int64_t height = cascade.rectH[i];
+        if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > cascade.window.width || y + height > cascade.window.height) {
+            throw cascadeError(path, "feature rectangle outside the window");
+        }
+    }
+}
+
+std::shared_ptr<const NativeCascade> viewNativeCascade(std::vector<unsigned char> bytes, MappedFile mapping, const std::string& path) {
+    auto cascade = std::make_shared<NativeCascade>();
+    cascade->ownedBytes = std::move(bytes);
+    cascade->mapping = std::move(mapping);
+    const unsigned char* data = cascade->ownedBytes.empty() ? cascade->mapping.data() : cascade->ownedBytes.data();
+    size_t size = cascade->ownedBytes.empty() ? cascade->mapping.size() : cascade->ownedBytes.size();
+
+    NativeCascadeHeader header;
+    if (size < sizeof(header)) {
+        throw cascadeError(path, "file too short");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, cascadeMagic, sizeof(cascadeMagic)) != 0) {
+        throw cascadeError(path, "not a FaceLib binary cascade");
+    }
+    if (header.version != cascadeVersion || header.byteOrder != cascadeByteOrder) {
+        throw cascadeError(path, "unsupported format version or byte order");
+    }
+    for (int section = 0; section < NativeCascadeHeader::SectionCount; ++section) {
+        uint64_t offset = header.sectionOffset[section];
+        // Every element type is 4 bytes wide.
+        if (offset % sectionAlignment != 0 || offset > size || sectionLength(header, section) > (size - offset) / 4) {
+            throw cascadeError(path, "section outside the file");
+        }
+    }
+
+    auto section = [&](int index) { return data + header.sectionOffset[index]; };
+    cascade->window = cv::Size(static_cast<int>(header.windowWidth), static_cast<int>(header.windowHeight));
+    cascade->stageCount = header.stageCount;
+    cascade->treeCount = header.treeCount;
+    cascade->nodeCount = header.nodeCount;
+    cascade->leafCount = header.leafCount;
+    cascade->featureCount = header.featureCount;
+    cascade->stageThreshold = reinterpret_cast<const float*>(section(NativeCascadeHeader::StageThreshold));
+    cascade->stageTreeCount = reinterpret_cast<const uint32_t*>(section(NativeCascadeHeader::StageTreeCount));
+    cascade->treeNodeCount = reinterpret_cast<const uint32_t*>(section(NativeCascadeHeader::TreeNodeCount));
+    cascade->nodeLeft = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::NodeLeft));
+    cascade->nodeRight = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::NodeRight));
+    cascade->nodeFeature = reinterpret_cast<const uint32_t*>(section(NativeCascadeHeader::NodeFeature));
+    cascade->nodeThreshold = reinterpret_cast<const float*>(section(NativeCascadeHeader::NodeThreshold));
+    cascade->leafValue = reinterpret_cast<const float*>(section(NativeCascadeHeader::LeafValue));
+    cascade->rectX = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::RectX));
+    cascade->rectY = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::RectY));
+    cascade->rectW = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::RectW));
+    cascade->rectH = reinterpret_cast<const int32_t*>(section(NativeCascadeHeader::RectH));
+    cascade->rectWeight = reinterpret_cast<const float*>(section(NativeCascadeHeader::RectWeight));
+    if (cascade->window.width <= 0 || cascade->window.height <= 0) {
+        throw cascadeError(path, "invalid window size");
+    }
+    validate(*cascade, path);
+    return cascade;
+}
+
+std::shared_ptr<const NativeCascade> loadNativeCascade(const std::string& path) {
+    return viewNativeCascade(std::vector<unsigned char>(), MappedFile::open(path), path);
+}
+
+bool isNativeCascadeFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(cascadeMagic)] = {};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, cascadeMagic, sizeof(cascadeMagic)) == 0;
+}
+
+std::shared_ptr<const NativeCascade> tryCompileNativeCascade(const cv::FileNode& cascade, const std::string& path) {
+    try {
+        return viewNativeCascade(compileNativeCascade(cascade, path), MappedFile(), path);
+    } catch (const FaceDetectionException& e) {
+        FACELIB_TRACE("Cascade left to OpenCV: " << e.what());
+        return nullptr;
+    }
+}
+
+FACELIB_API void compileCascade(const std::string& cascadePath, const std::string& outputPath) {
+    cv::FileStorage storage;
+    try {
+        storage.open(cascadePath, cv::FileStorage::READ);
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error reading cascade " + cascadePath + ": " + e.what());
+    }
+    if (!storage.isOpened()) {
+        throw FaceDetectionException("Failed to load cascade from: " + cascadePath);
+    }
+
+    std::vector<unsigned char> bytes = compileNativeCascade(storage.getFirstTopLevelNode(), cascadePath);
+    viewNativeCascade(bytes, MappedFile(), cascadePath);  // never write a file the loader would reject
+    writeBinaryToFile(bytes, outputPath);
+}
+
+// Integral images of level with a zero first row and column, as cv::integral lays them out, padded
+// for the row kernels' overrun. Sums are kept modulo 2^32 like OpenCV's 32-bit integrals; window sums
+// are small enough to come out exact.
+static void computeIntegrals(const cv::Mat& level, NativeScratch& scratch) {
+    size_t stride = static_cast<size_t>(level.cols) + 1;
+    scratch.sum.resize(stride * (level.rows + 1) + nativeKernelOverrun);
+    scratch.sqsum.resize(stride * (level.rows + 1) + nativeKernelOverrun);
+    uint32_t* sum = scratch.sum.data();
+    uint32_t* sqsum = scratch.sqsum.data();
+    std::fill(sum, sum + stride, 0u);
+    std::fill(sqsum, sqsum + stride, 0u);
+
+    for (int y = 0; y < level.rows; ++y) {
+        const unsigned char* row = level.ptr<unsigned char>(y);
+        const uint32_t* sumAbove = sum + y * stride;
+        const uint32_t* sqsumAbove = sqsum + y * stride;
+        uint32_t* sumRow = sum + (y + 1) * stride;
+        uint32_t* sqsumRow = sqsum + (y + 1) * stride;
+        uint32_t rowSum = 0;
+        uint32_t rowSqsum = 0;
+        sumRow[0] = 0;
+        sqsumRow[0] = 0;
+        for (int x = 0; x < level.cols; ++x) {
+            uint32_t value = row[x];
+            rowSum += value;
+            rowSqsum += value * value;
+            sumRow[x + 1] = sumAbove[x + 1] + rowSum;
+            sqsumRow[x + 1] = sqsumAbove[x + 1] + rowSqsum;
+        }
+    }
+}
+
+static void rectOffsets(int x, int y, int width, int height, int stride, int* offsets) {
+    offsets[0] = y * stride + x;
+    offsets[1] = y * stride + x + width;
+    offsets[2] = (y + height) * stride + x;
+    offsets[3] = (y + height) * stride + x + width;
+}
+
+// Corner offsets of every feature rectangle for an integral image with the given row stride.
+static void prepareOffsets(const NativeCascade& cascade, int stride, NativeScratch& scratch) {
+    if (scratch.offsetsCascade == &cascade && scratch.offsetsStride == stride) {
+        return;
+    }
+    uint32_t features = cascade.featureCount;
+    scratch.offsets.resize(12 * static_cast<size_t>(features));
+    for (uint32_t f = 0; f < features; ++f) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            size_t index = k * features + f;
+            if (k == 2 && cascade.rectWeight[index] == 0.0f) {
+                // Never read, and not validated either.
+                std::fill_n(&scratch.offsets[12 * f + 8], 4, 0);
+                continue;
+            }
+            rectOffsets(cascade.rectX[index], cascade.rectY[index], cascade.rectW[index], cascade.rectH[index], stride,
+                        &scratch.offsets[12 * f + 4 * k]);
+        }
+    }
+    // OpenCV normalises by the variance of the window minus a one-pixel border.
+    rectOffsets(1, 1, cascade.window.width - 2, cascade.window.height - 2, stride, scratch.normOffsets);
+    scratch.offsetsCascade = &cascade;
+    scratch.offsetsStride = stride;
+}
+
+static inline int rectSum(const uint32_t* window, const int* offsets) {
+    return static_cast<int>(window[offsets[0]] - window[offsets[1]] - window[offsets[2]] + window[offsets[3]]);
+}
+
+// Same arithmetic, in the same precision, as OpenCV's HaarEvaluator::OptFeature::calc().
+static inline float featureValue(const NativeCascade& cascade, const int* offsets, uint32_t feature, const uint32_t* window) {
+    uint32_t features = cascade.featureCount;
+    const int* corners = offsets + 12 * feature;
+    float value = cascade.rectWeight[feature] * rectSum(window, corners) +
+                  cascade.rectWeight[features + feature] * rectSum(window, corners + 4);
+    float third = cascade.rectWeight[2 * features + feature];
+    if (third != 0.0f) {
+        value += third * rectSum(window, corners + 8);
+    }
+    return value;
+}
+
+// Runs the cascade on the window whose integral starts at sum/sqsum. Returns 1 for a hit, minus the
+// index of the rejecting stage otherwise, and -1 for a window too flat to normalise - the values
+// CascadeClassifier::runAt() returns.
+static int evaluateWindow(const NativeCascade& cascade, const NativeScratch& scratch, const uint32_t* sum, const uint32_t* sqsum,
+                          double area) {
+    int valueSum = rectSum(sum, scratch.normOffsets);
+    uint32_t valueSqsum = static_cast<uint32_t>(rectSum(sqsum, scratch.normOffsets));
+    double norm = area * valueSqsum - static_cast<double>(valueSum) * valueSum;
+    if (norm <= 0.0) {
+        return -1;
+    }
+    float normFactor = static_cast<float>(1.0 / std::sqrt(norm));
+    if (!(area * normFactor < 1e-1)) {
+        return -1;
+    }
+
+    const int* offsets = scratch.offsets.data();
+    uint32_t tree = 0;
+    uint32_t node = 0;
+    uint32_t leaf = 0;
+    for (uint32_t stage = 0; stage < cascade.stageCount; ++stage) {
+        double stageSum = 0.0;
+        for (uint32_t t = 0; t < cascade.stageTreeCount[stage]; ++t, ++tree) {
+            uint32_t nodes = cascade.treeNodeCount[tree];
+            int32_t index = 0;
+            do {
+                uint32_t current = node + index;
+                float value = featureValue(cascade, offsets, cascade.nodeFeature[current], sum) * normFactor;
+                index = value < cascade.nodeThreshold[current] ? cascade.nodeLeft[current] : cascade.nodeRight[current];
+            } while (index > 0);
+            stageSum += cascade.leafValue[leaf - index];
+            node += nodes;
+            leaf += nodes + 1;
+        }
+        if (stageSum < cascade.stageThreshold[stage]) {
+            return -static_cast<int>(stage);
+        }
+    }
+    return 1;
+}
+
+static bool cpuSupports(SimdLevel level) {
+#ifdef FACELIB_SIMD_KERNELS
+    __builtin_cpu_init();
+    switch (level) {
+        case SimdLevel::SSE42: return __builtin_cpu_supports("sse4.2");
+        case SimdLevel::AVX2: return __builtin_cpu_supports("avx2");
+        case SimdLevel::AVX512: return __builtin_cpu_supports("avx512f");
+        default: return true;
+    }
+#else
+    return level == SimdLevel::Scalar;
+#endif
+}
+
+static std::atomic<SimdLevel>& simdLevel() {
+    static std::atomic<SimdLevel> level([] {
+        for (SimdLevel best : {SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE42}) {
+            if (cpuSupports(best)) {
+                return best;
+            }
+        }
+        return SimdLevel::Scalar;
+    }());
+    return level;
+}
+
+FACELIB_API bool isSimdLevelSupported(SimdLevel level) {
+    return cpuSupports(level);
+}
+
+FACELIB_API void setSimdLevel(SimdLevel level) {
+    if (!cpuSupports(level)) {
+        throw FaceDetectionException("SIMD level not supported by this CPU or FaceLib build");
+    }
+    simdLevel() = level;
+}
+
+FACELIB_API SimdLevel getSimdLevel() {
+    return simdLevel();
+}
+
+// Row kernel for the current SIMD level; null for the scalar evaluator.
+static NativeRowKernel rowKernel() {
+#ifdef FACELIB_SIMD_KERNELS
+    switch (getSimdLevel()) {
+        case SimdLevel::SSE42: return evaluateRowSSE42;
+        case SimdLevel::AVX2: return evaluateRowAVX2;
+        case SimdLevel::AVX512: return evaluateRowAVX512;
+        default: break;
+    }
+#endif
+    return nullptr;
+}
+
+void scanNativeLevel(const NativeCascade& cascade, const cv::Mat& level, float factor, NativeScratch& scratch,
+                     std::vector<cv::Rect>& hits) {
+    cv::Size window = cascade.window;
+    int workWidth = level.cols + 1 - window.width;
+    int workHeight = level.rows + 1 - window.height;
+    if (workWidth <= 0 || workHeight <= 0) {
+        return;
+    }
+
+    computeIntegrals(level, scratch);
+    int stride = level.cols + 1;
+    prepareOffsets(cascade, stride, scratch);
+
+    // detectMultiScale's sampling: every other position below scale 2, every position from there on,
+    // and the next position skipped whenever the first stage rejects a window.
+    int step = factor >= 2 ? 1 : 2;
+    cv::Size windowSize(cvRound(window.width * factor), cvRound(window.height * factor));
+    double area = static_cast<double>(window.width - 2) * (window.height - 2);
+
+    const int stripeRows = 32;  // a multiple of both steps, so stripes sample the same rows as one pass
+    int stripes = (workHeight + stripeRows - 1) / stripeRows;
+    if (scratch.stripeHits.size() < static_cast<size_t>(stripes)) {
+        scratch.stripeHits.resize(stripes);
+    }
+    for (int s = 0; s < stripes; ++s) {
+        scratch.stripeHits[s].clear();
+    }
+
+    // The row kernels evaluate every sampled window of a row at once; the skip rule is applied to
+    // their results afterwards, which reports exactly the windows the scalar scan would.
+    NativeRowKernel kernel = rowKernel();
+    int rowWindows = (workWidth + step - 1) / step;
+    if (kernel) {
+        scratch.results.resize(static_cast<size_t>(stripes) * rowWindows);
+    }
+
+    auto scanStripes = [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; ++s) {
+            int* results = kernel ? scratch.results.data() + static_cast<size_t>(s) * rowWindows : nullptr;
+            int yEnd = std::min(workHeight, (s + 1) * stripeRows);
+            for (int y = s * stripeRows; y < yEnd; y += step) {
+                const uint32_t* sumRow = scratch.sum.data() + static_cast<size_t>(y) * stride;
+                const uint32_t* sqsumRow = scratch.sqsum.data() + static_cast<size_t>(y) * stride;
+                if (kernel) {
+                    NativeKernelRow row = {&cascade, scratch.offsets.data(), scratch.normOffsets, sumRow, sqsumRow, area};
+                    kernel(row, step, rowWindows, results);
+                }
+                for (int i = 0; i < rowWindows; ++i) {
+                    int x = i * step;
+                    int result = kernel ? results[i] : evaluateWindow(cascade, scratch, sumRow + x, sqsumRow + x, area);
+                    if (result > 0) {
+                        scratch.stripeHits[s].emplace_back(cvRound(x * factor), cvRound(y * factor), windowSize.width, windowSize.height);
+                    } else if (result == 0) {
+                        ++i;
+                    }
+                }
+            }
+        }
+    };
+    if (scratch.parallel) {
+        cv::parallel_for_(cv::Range(0, stripes), scanStripes);
+    } else {
+        scanStripes(cv::Range(0, stripes));
+    }
+
+    for (int s = 0; s < stripes; ++s) {
+        hits.insert(hits.end(), scratch.stripeHits[s].begin(), scratch.stripeHits[s].end());
+    }
+}
+
+void detectNativeMultiScale(const NativeCascade& cascade, const cv::Mat& gray, double scaleFactor, cv::Size minSize,
+                            cv::Size maxSize, NativeScratch& scratch, std::vector<cv::Rect>& hits) {
+    if (maxSize.width <= 0 || maxSize.height <= 0) {
+        maxSize = gray.size();
+    }
+    cv::Mat level;
+    for (double factor = 1; ; factor *= scaleFactor) {
+        cv::Size windowSize(cvRound(cascade.window.width * factor), cvRound(cascade.window.height * factor));
+        if (windowSize.width > maxSize.width || windowSize.height > maxSize.height ||
+            windowSize.width > gray.cols || windowSize.height > gray.rows) {
+            break;
+        }
+        if (windowSize.width < minSize.width || windowSize.height < minSize.height) {
+            continue;
+        }
+
+        float scale = static_cast<float>(factor);
+        cv::Size levelSize(cvRound(gray.cols / scale), cvRound(gray.rows / scale));
+        if (levelSize == gray.size()) {
+            scanNativeLevel(cascade, gray, scale, scratch, hits);
+        } else {
+            cv::resize(gray, level, levelSize, 0, 0, cv::INTER_LINEAR_EXACT);
+            scanNativeLevel(cascade, level, scale, scratch, hits);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef FACELIB_NATIVECASCADE_H
+#define FACELIB_NATIVECASCADE_H
+
+#include "FaceLib.h"
+#include "NativeKernel.h"
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// FaceLib's own Haar cascade engine - not part of the public header.
+//
+// Binary cascade format (.flc): a fixed header followed by flat arrays, each starting on a 64-byte
+// boundary, in the host's little-endian byte order. A mapped file is used in place; loading only
+// validates it. Arrays, by section:
+//   StageThreshold   float[stageCount]    stage threshold, already lowered by OpenCV's 1e-5 epsilon
+//   StageTreeCount   uint32[stageCount]   trees in the stage, stored stage after stage
+//   TreeNodeCount    uint32[treeCount]    internal nodes of the tree; it has one more leaf than nodes
+//   NodeLeft/Right   int32[nodeCount]     child node index within the tree, or minus the leaf index
+//   NodeFeature      uint32[nodeCount]
+//   NodeThreshold    float[nodeCount]
+//   LeafValue        float[leafCount]
+//   RectX/Y/W/H      int32[3 * featureCount]  rectangle k of feature f at k * featureCount + f
+//   RectWeight       float[3 * featureCount]  0 for an unused third rectangle
+struct NativeCascadeHeader {
+    enum Section {
+        StageThreshold, StageTreeCount, TreeNodeCount, NodeLeft, NodeRight, NodeFeature, NodeThreshold,
+        LeafValue, RectX, RectY, RectW, RectH, RectWeight, SectionCount
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t windowWidth;
+    uint32_t windowHeight;
+    uint32_t stageCount;
+    uint32_t treeCount;
+    uint32_t nodeCount;
+    uint32_t leafCount;
+    uint32_t featureCount;
+    uint32_t reserved;
+    uint64_t sectionOffset[SectionCount];
+};
+
+// A validated cascade: pointers into the mapped file or into bytes built from XML.
+class NativeCascade : public NativeCascadeArrays {
+public:
+    cv::Size window;
+
+private:
+    friend std::shared_ptr<const NativeCascade> viewNativeCascade(std::vector<unsigned char> bytes, MappedFile mapping,
+                                                                  const std::string& path);
+    std::vector<unsigned char> ownedBytes;
+    MappedFile mapping;
+};
+
+// Builds or validates the binary form. Throw FaceDetectionException on malformed input.
+std::vector<unsigned char> compileNativeCascade(const cv::FileNode& cascade, const std::string& path);
+std::shared_ptr<const NativeCascade> viewNativeCascade(std::vector<unsigned char> bytes, MappedFile mapping,
+                                                       const std::string& path);
+std::shared_ptr<const NativeCascade> loadNativeCascade(const std::string& path);
+bool isNativeCascadeFile(const std::string& path);
+// Compiles an XML cascade in memory, or returns null for cascades the engine cannot run (LBP, tilted
+// Haar features, the old cascade format), which are left to cv::CascadeClassifier.
+std::shared_ptr<const NativeCascade> tryCompileNativeCascade(const cv::FileNode& cascade, const std::string& path);
+
+// Per-thread buffers of the evaluator: the integral images of the level being scanned, the feature
+// corner offsets for their row stride, the row kernels' per-window results and the hits of each row
+// stripe. They only ever grow, so a scratch reused for same-sized levels stops allocating.
+struct NativeScratch {
+    std::vector<uint32_t> sum;
+    std::vector<uint32_t> sqsum;
+    std::vector<int> results;
+    std::vector<std::vector<cv::Rect>> stripeHits;
+    bool parallel = true;  // false scans every stripe on the calling thread
+    std::vector<int> offsets;       // 12 per feature: 4 corners of each of 3 rectangles
+    int normOffsets[4] = {0, 0, 0, 0};
+    int offsetsStride = 0;
+    const NativeCascade* offsetsCascade = nullptr;
+};
+
+// Scans one pyramid level - the grayscale image scaled down by factor - the way detectMultiScale scans
+// the same scale, and appends the raw, ungrouped hits in image coordinates.
+void scanNativeLevel(const NativeCascade& cascade, const cv::Mat& level, float factor, NativeScratch& scratch,
+                     std::vector<cv::Rect>& hits);
+
+// detectMultiScale without grouping: builds the pyramid for gray and scans every level.
+void detectNativeMultiScale(const NativeCascade& cascade, const cv::Mat& gray, double scaleFactor, cv::Size minSize,
+                            cv::Size maxSize, NativeScratch& scratch, std::vector<cv::Rect>& hits);
+
+#endif //FACELIB_NATIVECASCADE_H
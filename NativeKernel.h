@@ -0,0 +1,59 @@
+#ifndef FACELIB_NATIVEKERNEL_H
+#define FACELIB_NATIVEKERNEL_H
+
+#include <cstdint>
+
+// Vectorised row kernels of the native cascade engine - not part of the public header.
+//
+// Each instruction set has its own translation unit, compiled with that instruction set enabled and
+// picked at run time. They include nothing but this header and the intrinsics, so no inline library
+// code is ever compiled there for a CPU that might lack the instructions.
+
+// The arrays of a NativeCascade, as described in NativeCascade.h.
+struct NativeCascadeArrays {
+    uint32_t stageCount = 0;
+    uint32_t treeCount = 0;
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t featureCount = 0;
+
+    const float* stageThreshold = nullptr;
+    const uint32_t* stageTreeCount = nullptr;
+    const uint32_t* treeNodeCount = nullptr;
+    const int32_t* nodeLeft = nullptr;
+    const int32_t* nodeRight = nullptr;
+    const uint32_t* nodeFeature = nullptr;
+    const float* nodeThreshold = nullptr;
+    const float* leafValue = nullptr;
+    const int32_t* rectX = nullptr;
+    const int32_t* rectY = nullptr;
+    const int32_t* rectW = nullptr;
+    const int32_t* rectH = nullptr;
+    const float* rectWeight = nullptr;
+};
+
+// One row of windows to evaluate: the integral images at the first window and the corner offsets of
+// every feature rectangle (12 per feature) and of the normalisation rectangle for their row stride.
+// Kernels read up to nativeKernelOverrun elements past the last window's corners, so the integral
+// buffers must be padded by that much.
+struct NativeKernelRow {
+    const NativeCascadeArrays* cascade;
+    const int* offsets;
+    const int* normOffsets;
+    const uint32_t* sum;
+    const uint32_t* sqsum;
+    double area;  // of the normalisation rectangle
+};
+
+const int nativeKernelOverrun = 32;
+
+// Evaluates the count windows at 0, step, 2 * step, ... along the row (step is 1 or 2) and stores
+// what CascadeClassifier::runAt() would return for each in results. Every window is evaluated, so
+// the caller applies detectMultiScale's skip-after-rejection rule itself.
+typedef void (*NativeRowKernel)(const NativeKernelRow& row, int step, int count, int* results);
+
+void evaluateRowSSE42(const NativeKernelRow& row, int step, int count, int* results);
+void evaluateRowAVX2(const NativeKernelRow& row, int step, int count, int* results);
+void evaluateRowAVX512(const NativeKernelRow& row, int step, int count, int* results);
+
+#endif //FACELIB_NATIVEKERNEL_H
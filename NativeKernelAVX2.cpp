@@ -0,0 +1,64 @@
+#include "NativeKernel.h"
+#include <immintrin.h>
+
+// AVX2 row kernel: eight windows per vector.
+
+namespace {
+
+const int lanes = 8;
+typedef __m256i VInt;
+typedef __m256 VFloat;
+typedef __m256d VDouble;
+typedef __m256i VMask;  // all bits set in selected lanes
+
+// AVX2 shuffles stay within 128-bit halves; this puts the 64-bit quarters [0 2 1 3] back in order.
+inline __m256i orderQuarters(__m256 a) {
+    return _mm256_castpd_si256(_mm256_permute4x64_pd(_mm256_castps_pd(a), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+inline VInt loadInt(const uint32_t* values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)); }
+inline void storeInt(int32_t* values, VInt a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), a); }
+inline VInt evens(VInt a, VInt b) {
+    return orderQuarters(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+inline VInt setInt(int value) { return _mm256_set1_epi32(value); }
+inline VInt addInt(VInt a, VInt b) { return _mm256_add_epi32(a, b); }
+inline VInt subInt(VInt a, VInt b) { return _mm256_sub_epi32(a, b); }
+inline VMask equalInt(VInt a, VInt b) { return _mm256_cmpeq_epi32(a, b); }
+inline VInt selectInt(VMask mask, VInt a, VInt b) { return _mm256_blendv_epi8(b, a, mask); }
+
+inline VFloat toFloat(VInt a) { return _mm256_cvtepi32_ps(a); }
+inline VFloat setFloat(float value) { return _mm256_set1_ps(value); }
+inline VFloat addFloat(VFloat a, VFloat b) { return _mm256_add_ps(a, b); }
+inline VFloat mulFloat(VFloat a, VFloat b) { return _mm256_mul_ps(a, b); }
+inline VMask lessFloat(VFloat a, VFloat b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+inline VFloat selectFloat(VMask mask, VFloat a, VFloat b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+
+inline VDouble setDouble(double value) { return _mm256_set1_pd(value); }
+inline VDouble addDouble(VDouble a, VDouble b) { return _mm256_add_pd(a, b); }
+inline VDouble subDouble(VDouble a, VDouble b) { return _mm256_sub_pd(a, b); }
+inline VDouble mulDouble(VDouble a, VDouble b) { return _mm256_mul_pd(a, b); }
+inline VDouble divDouble(VDouble a, VDouble b) { return _mm256_div_pd(a, b); }
+inline VDouble sqrtDouble(VDouble a) { return _mm256_sqrt_pd(a); }
+inline VDouble signedLow(VInt a) { return _mm256_cvtepi32_pd(_mm256_castsi256_si128(a)); }
+inline VDouble signedHigh(VInt a) { return _mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)); }
+inline VDouble floatLow(VFloat a) { return _mm256_cvtps_pd(_mm256_castps256_ps128(a)); }
+inline VDouble floatHigh(VFloat a) { return _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)); }
+inline VFloat joinFloat(VDouble low, VDouble high) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+}
+// Lanes where a < b, for both halves.
+inline VMask lessDouble(VDouble aLow, VDouble aHigh, VDouble bLow, VDouble bHigh) {
+    __m256 low = _mm256_castpd_ps(_mm256_cmp_pd(aLow, bLow, _CMP_LT_OQ));
+    __m256 high = _mm256_castpd_ps(_mm256_cmp_pd(aHigh, bHigh, _CMP_LT_OQ));
+    return orderQuarters(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+inline VMask maskAnd(VMask a, VMask b) { return _mm256_and_si256(a, b); }
+inline VMask maskAndNot(VMask a, VMask b) { return _mm256_andnot_si256(b, a); }
+inline bool maskAny(VMask mask) { return _mm256_movemask_epi8(mask) != 0; }
+
+} // namespace
+
+#define NATIVE_ROW_KERNEL evaluateRowAVX2
+#include "NativeKernelBody.inl"
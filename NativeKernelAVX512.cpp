@@ -0,0 +1,62 @@
+#include "NativeKernel.h"
+#include <immintrin.h>
+
+// AVX-512 row kernel: sixteen windows per vector. Needs AVX512F only.
+
+namespace {
+
+const int lanes = 16;
+typedef __m512i VInt;
+typedef __m512 VFloat;
+typedef __m512d VDouble;
+typedef __mmask16 VMask;
+
+inline VInt loadInt(const uint32_t* values) { return _mm512_loadu_si512(values); }
+inline void storeInt(int32_t* values, VInt a) { _mm512_storeu_si512(values, a); }
+inline VInt evens(VInt a, VInt b) {
+    return _mm512_permutex2var_epi32(a, _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30), b);
+}
+inline VInt setInt(int value) { return _mm512_set1_epi32(value); }
+inline VInt addInt(VInt a, VInt b) { return _mm512_add_epi32(a, b); }
+inline VInt subInt(VInt a, VInt b) { return _mm512_sub_epi32(a, b); }
+inline VMask equalInt(VInt a, VInt b) { return _mm512_cmpeq_epi32_mask(a, b); }
+inline VInt selectInt(VMask mask, VInt a, VInt b) { return _mm512_mask_blend_epi32(mask, b, a); }
+
+inline VFloat toFloat(VInt a) { return _mm512_cvtepi32_ps(a); }
+inline VFloat setFloat(float value) { return _mm512_set1_ps(value); }
+inline VFloat addFloat(VFloat a, VFloat b) { return _mm512_add_ps(a, b); }
+inline VFloat mulFloat(VFloat a, VFloat b) { return _mm512_mul_ps(a, b); }
+inline VMask lessFloat(VFloat a, VFloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+inline VFloat selectFloat(VMask mask, VFloat a, VFloat b) { return _mm512_mask_blend_ps(mask, b, a); }
+
+inline VDouble setDouble(double value) { return _mm512_set1_pd(value); }
+inline VDouble addDouble(VDouble a, VDouble b) { return _mm512_add_pd(a, b); }
+inline VDouble subDouble(VDouble a, VDouble b) { return _mm512_sub_pd(a, b); }
+inline VDouble mulDouble(VDouble a, VDouble b) { return _mm512_mul_pd(a, b); }
+inline VDouble divDouble(VDouble a, VDouble b) { return _mm512_div_pd(a, b); }
+inline VDouble sqrtDouble(VDouble a) { return _mm512_sqrt_pd(a); }
+inline VDouble signedLow(VInt a) { return _mm512_cvtepi32_pd(_mm512_castsi512_si256(a)); }
+inline VDouble signedHigh(VInt a) { return _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(a, 1)); }
+inline VDouble floatLow(VFloat a) { return _mm512_cvtps_pd(_mm512_castps512_ps256(a)); }
+inline VDouble floatHigh(VFloat a) {
+    return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)));
+}
+inline VFloat joinFloat(VDouble low, VDouble high) {
+    __m512d lowHalf = _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(low)));
+    return _mm512_castpd_ps(_mm512_insertf64x4(lowHalf, _mm256_castps_pd(_mm512_cvtpd_ps(high)), 1));
+}
+// Lanes where a < b, for both halves.
+inline VMask lessDouble(VDouble aLow, VDouble aHigh, VDouble bLow, VDouble bHigh) {
+    unsigned low = _mm512_cmp_pd_mask(aLow, bLow, _CMP_LT_OQ);
+    unsigned high = _mm512_cmp_pd_mask(aHigh, bHigh, _CMP_LT_OQ);
+    return static_cast<VMask>(low | (high << 8));
+}
+
+inline VMask maskAnd(VMask a, VMask b) { return static_cast<VMask>(a & b); }
+inline VMask maskAndNot(VMask a, VMask b) { return static_cast<VMask>(a & ~b); }
+inline bool maskAny(VMask mask) { return mask != 0; }
+
+} // namespace
+
+#define NATIVE_ROW_KERNEL evaluateRowAVX512
+#include "NativeKernelBody.inl"
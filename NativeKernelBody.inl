@@ -0,0 +1,132 @@
+// Shared body of the vectorised row kernels, included by each instruction-set translation unit once it
+// has defined, for its own vector width: lanes, VInt, VFloat, VDouble (half as many lanes), VMask and
+// the primitives used below. Lane i evaluates the window at i * step from the vector's first window.
+//
+// The arithmetic is HaarEvaluator's, operation for operation: integer rectangle sums, float feature
+// values, double variance normalisation and double stage sums, with leaves added in tree order. Windows
+// are evaluated side by side until every lane has been rejected; a rejected lane keeps the stage index
+// runAt() would have returned.
+
+namespace {
+
+inline VInt loadWindows(const uint32_t* first, int step) {
+    return step == 1 ? loadInt(first) : evens(loadInt(first), loadInt(first + lanes));
+}
+
+inline VInt rectSums(const uint32_t* window, const int* corners, int step) {
+    VInt sums = subInt(loadWindows(window + corners[0], step), loadWindows(window + corners[1], step));
+    sums = subInt(sums, loadWindows(window + corners[2], step));
+    return addInt(sums, loadWindows(window + corners[3], step));
+}
+
+inline VFloat featureValues(const NativeKernelRow& row, uint32_t feature, const uint32_t* window, int step) {
+    const NativeCascadeArrays& cascade = *row.cascade;
+    uint32_t features = cascade.featureCount;
+    const int* corners = row.offsets + 12 * feature;
+    VFloat value = addFloat(mulFloat(setFloat(cascade.rectWeight[feature]), toFloat(rectSums(window, corners, step))),
+                            mulFloat(setFloat(cascade.rectWeight[features + feature]), toFloat(rectSums(window, corners + 4, step))));
+    float third = cascade.rectWeight[2 * features + feature];
+    if (third != 0.0f) {
+        value = addFloat(value, mulFloat(setFloat(third), toFloat(rectSums(window, corners + 8, step))));
+    }
+    return value;
+}
+
+inline VDouble unsignedLow(VInt values) {
+    // Flipping the top bit turns the unsigned range into the signed one.
+    return addDouble(signedLow(addInt(values, setInt(INT32_MIN))), setDouble(2147483648.0));
+}
+
+inline VDouble unsignedHigh(VInt values) {
+    return addDouble(signedHigh(addInt(values, setInt(INT32_MIN))), setDouble(2147483648.0));
+}
+
+// Variance normalisation factor of each window; valid is cleared for windows too flat to normalise.
+inline VFloat normFactors(const NativeKernelRow& row, const uint32_t* sum, const uint32_t* sqsum, int step, VMask& valid) {
+    VInt valueSum = rectSums(sum, row.normOffsets, step);
+    VInt valueSqsum = rectSums(sqsum, row.normOffsets, step);
+    VDouble area = setDouble(row.area);
+    VDouble normLow = subDouble(mulDouble(area, unsignedLow(valueSqsum)), mulDouble(signedLow(valueSum), signedLow(valueSum)));
+    VDouble normHigh = subDouble(mulDouble(area, unsignedHigh(valueSqsum)), mulDouble(signedHigh(valueSum), signedHigh(valueSum)));
+    VDouble one = setDouble(1.0);
+    VFloat factor = joinFloat(divDouble(one, sqrtDouble(normLow)), divDouble(one, sqrtDouble(normHigh)));
+
+    VDouble zero = setDouble(0.0);
+    VDouble limit = setDouble(1e-1);
+    valid = maskAnd(lessDouble(zero, zero, normLow, normHigh),
+                    lessDouble(mulDouble(area, floatLow(factor)), mulDouble(area, floatHigh(factor)), limit, limit));
+    return factor;
+}
+
+inline VMask goesLeft(const NativeKernelRow& row, uint32_t node, const uint32_t* sum, int step, VFloat factor) {
+    VFloat value = mulFloat(featureValues(row, row.cascade->nodeFeature[node], sum, step), factor);
+    return lessFloat(value, setFloat(row.cascade->nodeThreshold[node]));
+}
+
+// Leaf value each window reaches in the tree whose nodes and leaves start at node and leaf.
+inline VFloat evaluateTree(const NativeKernelRow& row, uint32_t node, uint32_t leaf, uint32_t nodes, const uint32_t* sum,
+                           int step, VFloat factor, VMask active) {
+    const NativeCascadeArrays& cascade = *row.cascade;
+    if (nodes == 1) {
+        VMask left = goesLeft(row, node, sum, step, factor);
+        return selectFloat(left, setFloat(cascade.leafValue[leaf - cascade.nodeLeft[node]]),
+                           setFloat(cascade.leafValue[leaf - cascade.nodeRight[node]]));
+    }
+
+    // Children always follow their parent, so visiting the nodes in order moves every window down its
+    // own path. Afterwards current holds minus the leaf index, as in runAt().
+    VInt current = setInt(0);
+    for (uint32_t n = 0; n < nodes; ++n) {
+        VMask here = maskAnd(active, equalInt(current, setInt(static_cast<int>(n))));
+        if (!maskAny(here)) {
+            continue;
+        }
+        VMask left = goesLeft(row, node + n, sum, step, factor);
+        current = selectInt(here, selectInt(left, setInt(cascade.nodeLeft[node + n]), setInt(cascade.nodeRight[node + n])), current);
+    }
+    VFloat value = setFloat(0.0f);
+    for (uint32_t j = 0; j <= nodes; ++j) {
+        value = selectFloat(equalInt(current, setInt(-static_cast<int>(j))), setFloat(cascade.leafValue[leaf + j]), value);
+    }
+    return value;
+}
+
+} // namespace
+
+void NATIVE_ROW_KERNEL(const NativeKernelRow& row, int step, int count, int* results) {
+    const NativeCascadeArrays& cascade = *row.cascade;
+    int32_t laneResults[lanes];
+    for (int first = 0; first < count; first += lanes) {
+        const uint32_t* sum = row.sum + first * step;
+        const uint32_t* sqsum = row.sqsum + first * step;
+
+        VMask active;
+        VFloat factor = normFactors(row, sum, sqsum, step, active);
+        VInt result = selectInt(active, setInt(1), setInt(-1));
+        uint32_t tree = 0;
+        uint32_t node = 0;
+        uint32_t leaf = 0;
+        for (uint32_t stage = 0; stage < cascade.stageCount && maskAny(active); ++stage) {
+            VDouble stageLow = setDouble(0.0);
+            VDouble stageHigh = setDouble(0.0);
+            for (uint32_t t = 0; t < cascade.stageTreeCount[stage]; ++t, ++tree) {
+                uint32_t nodes = cascade.treeNodeCount[tree];
+                VFloat value = evaluateTree(row, node, leaf, nodes, sum, step, factor, active);
+                stageLow = addDouble(stageLow, floatLow(value));
+                stageHigh = addDouble(stageHigh, floatHigh(value));
+                node += nodes;
+                leaf += nodes + 1;
+            }
+            VDouble threshold = setDouble(cascade.stageThreshold[stage]);
+            VMask rejected = maskAnd(active, lessDouble(stageLow, stageHigh, threshold, threshold));
+            result = selectInt(rejected, setInt(-static_cast<int>(stage)), result);
+            active = maskAndNot(active, rejected);
+        }
+
+        storeInt(laneResults, result);
+        int windows = count - first < lanes ? count - first : lanes;
+        for (int i = 0; i < windows; ++i) {
+            results[first + i] = laneResults[i];
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#include "NativeKernel.h"
+#include <immintrin.h>
+
+// SSE4.2 row kernel: four windows per vector.
+
+namespace {
+
+const int lanes = 4;
+typedef __m128i VInt;
+typedef __m128 VFloat;
+typedef __m128d VDouble;
+typedef __m128i VMask;  // all bits set in selected lanes
+
+inline VInt loadInt(const uint32_t* values) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+inline void storeInt(int32_t* values, VInt a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(values), a); }
+inline VInt evens(VInt a, VInt b) {
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+inline VInt setInt(int value) { return _mm_set1_epi32(value); }
+inline VInt addInt(VInt a, VInt b) { return _mm_add_epi32(a, b); }
+inline VInt subInt(VInt a, VInt b) { return _mm_sub_epi32(a, b); }
+inline VMask equalInt(VInt a, VInt b) { return _mm_cmpeq_epi32(a, b); }
+inline VInt selectInt(VMask mask, VInt a, VInt b) { return _mm_blendv_epi8(b, a, mask); }
+
+inline VFloat toFloat(VInt a) { return _mm_cvtepi32_ps(a); }
+inline VFloat setFloat(float value) { return _mm_set1_ps(value); }
+inline VFloat addFloat(VFloat a, VFloat b) { return _mm_add_ps(a, b); }
+inline VFloat mulFloat(VFloat a, VFloat b) { return _mm_mul_ps(a, b); }
+inline VMask lessFloat(VFloat a, VFloat b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+inline VFloat selectFloat(VMask mask, VFloat a, VFloat b) { return _mm_blendv_ps(b, a, _mm_castsi128_ps(mask)); }
+
+inline VDouble setDouble(double value) { return _mm_set1_pd(value); }
+inline VDouble addDouble(VDouble a, VDouble b) { return _mm_add_pd(a, b); }
+inline VDouble subDouble(VDouble a, VDouble b) { return _mm_sub_pd(a, b); }
+inline VDouble mulDouble(VDouble a, VDouble b) { return _mm_mul_pd(a, b); }
+inline VDouble divDouble(VDouble a, VDouble b) { return _mm_div_pd(a, b); }
+inline VDouble sqrtDouble(VDouble a) { return _mm_sqrt_pd(a); }
+inline VDouble signedLow(VInt a) { return _mm_cvtepi32_pd(a); }
+inline VDouble signedHigh(VInt a) { return _mm_cvtepi32_pd(_mm_unpackhi_epi64(a, a)); }
+inline VDouble floatLow(VFloat a) { return _mm_cvtps_pd(a); }
+inline VDouble floatHigh(VFloat a) { return _mm_cvtps_pd(_mm_movehl_ps(a, a)); }
+inline VFloat joinFloat(VDouble low, VDouble high) { return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high)); }
+// Lanes where a < b, for both halves.
+inline VMask lessDouble(VDouble aLow, VDouble aHigh, VDouble bLow, VDouble bHigh) {
+    __m128 low = _mm_castpd_ps(_mm_cmplt_pd(aLow, bLow));
+    __m128 high = _mm_castpd_ps(_mm_cmplt_pd(aHigh, bHigh));
+    return _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+inline VMask maskAnd(VMask a, VMask b) { return _mm_and_si128(a, b); }
+inline VMask maskAndNot(VMask a, VMask b) { return _mm_andnot_si128(b, a); }
+inline bool maskAny(VMask mask) { return _mm_movemask_epi8(mask) != 0; }
+
+} // namespace
+
+#define NATIVE_ROW_KERNEL evaluateRowSSE42
+#include "NativeKernelBody.inl"
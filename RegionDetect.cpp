@@ -0,0 +1,136 @@
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <memory>
+
+// Grows every region by margin and clips it to the image into grown, then merges regions that overlap
+// into their bounding box, so no pixel is scanned twice. A merged box can cover area outside every
+// grown region; faces found there are dropped by the caller.
+static std::vector<cv::Rect> prepareRegions(const std::vector<cv::Rect>& regions, int margin, cv::Size imageSize,
+                                            std::vector<cv::Rect>& grown) {
+    grown.clear();
+    cv::Rect bounds(cv::Point(0, 0), imageSize);
+    for (const auto& region : regions) {
+        cv::Rect rect(region.x - margin, region.y - margin, region.width + 2 * margin, region.height + 2 * margin);
+        rect &= bounds;
+        if (rect.area() > 0) {
+            grown.push_back(rect);
+        }
+    }
+
+    std::vector<cv::Rect> prepared = grown;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < prepared.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < prepared.size(); ++j) {
+                if ((prepared[i] & prepared[j]).area() > 0) {
+                    prepared[i] |= prepared[j];
+                    prepared.erase(prepared.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    return prepared;
+}
+
+// Scans each region as its own image on the worker pool and maps the faces back to image coordinates,
+// keeping those centred in one of the requested regions.
+static std::vector<FaceRect> detectInRegions(const FaceDetector* detector, const ImageData* image, const std::vector<cv::Rect>& regions,
+                                             int margin, double scaleFactor, int minNeighbors, int minSize) {
+    std::vector<cv::Rect> requested;
+    std::vector<cv::Rect> scanned = prepareRegions(regions, margin, image->mat.size(), requested);
+
+    // Views into the image, detected through the batch path, which never caches a pyramid.
+    std::vector<ImageData> views;
+    views.reserve(scanned.size());
+    std::vector<const ImageData*> batch;
+    for (const auto& region : scanned) {
+        views.emplace_back(image->mat(region), image->borrowed);
+        batch.push_back(&views.back());
+    }
+
+    std::vector<FaceRect> faces;
+    if (batch.empty()) {
+        return faces;
+    }
+    std::vector<std::vector<FaceRect>> regionFaces = detectFacesBatch(detector, batch, scaleFactor, minNeighbors, minSize);
+    for (size_t i = 0; i < scanned.size(); ++i) {
+        for (const auto& face : regionFaces[i]) {
+            cv::Point centre(face.x + scanned[i].x + face.width / 2, face.y + scanned[i].y + face.height / 2);
+            bool inside = std::any_of(requested.begin(), requested.end(), [&](const cv::Rect& region) {
+                return region.contains(centre);
+            });
+            if (inside) {
+                faces.emplace_back(face.x + scanned[i].x, face.y + scanned[i].y, face.width, face.height);
+            }
+        }
+    }
+
+    FACELIB_LOG_INFO("Detected " << faces.size() << " face(s) in " << scanned.size() << " region(s)");
+    return faces;
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const std::vector<FaceRect>& regions, int margin,
+                                              double scaleFactor, int minNeighbors, int minSize) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFaces(detector.get(), image, regions, margin, scaleFactor, minNeighbors, minSize);
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const std::vector<FaceRect>& regions,
+                                              int margin, double scaleFactor, int minNeighbors, int minSize) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    checkScaleFactor(scaleFactor);
+
+    std::vector<cv::Rect> rects;
+    rects.reserve(regions.size());
+    for (const auto& region : regions) {
+        rects.emplace_back(region.x, region.y, region.width, region.height);
+    }
+    return detectInRegions(detector, image, rects, margin, scaleFactor, minNeighbors, minSize);
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const ImageData* image, const ImageData* mask, int margin,
+                                              double scaleFactor, int minNeighbors, int minSize) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFaces(detector.get(), image, mask, margin, scaleFactor, minNeighbors, minSize);
+}
+
+FACELIB_API std::vector<FaceRect> detectFaces(const FaceDetector* detector, const ImageData* image, const ImageData* mask,
+                                              int margin, double scaleFactor, int minNeighbors, int minSize) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    checkScaleFactor(scaleFactor);
+    if (!mask || mask->mat.empty()) {
+        throw ImageProcessingException("Detection mask is empty or null");
+    }
+    if (mask->mat.size() != image->mat.size() || mask->mat.type() != CV_8UC1) {
+        throw ImageProcessingException("Detection mask must be a single-channel 8-bit image of the same size as the image");
+    }
+
+    try {
+        // Each connected area of the mask is scanned through its bounding box.
+        cv::Mat labels, stats, centroids;
+        int count = cv::connectedComponentsWithStats(mask->mat != 0, labels, stats, centroids, 8, CV_32S);
+        std::vector<cv::Rect> regions;
+        for (int label = 1; label < count; ++label) {
+            regions.emplace_back(stats.at<int>(label, cv::CC_STAT_LEFT), stats.at<int>(label, cv::CC_STAT_TOP),
+                                 stats.at<int>(label, cv::CC_STAT_WIDTH), stats.at<int>(label, cv::CC_STAT_HEIGHT));
+        }
+        return detectInRegions(detector, image, regions, margin, scaleFactor, minNeighbors, minSize);
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error while reading detection mask: " + std::string(e.what()));
+    }
+}
\ No newline at end of file
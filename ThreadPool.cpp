@@ -0,0 +1,142 @@
+#include "ThreadPool.h"
+#include "FaceLib.h"
+#include <atomic>
+#include <exception>
+
+struct ThreadPool::Job {
+    Job(size_t count, const Task& task) : count(count), task(task) {}
+
+    // Claims and runs items until none are left. Returns false if there was nothing to claim.
+    bool run(size_t slot) {
+        bool ranAny = false;
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            ranAny = true;
+            try {
+                task(i, slot);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            if (done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                doneCondition.notify_all();
+            }
+        }
+        return ranAny;
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [this] { return done.load() == count; });
+    }
+
+    const size_t count;
+    const Task& task;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t workerCount) {
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const Task& task) {
+    if (count == 0) {
+        return;
+    }
+
+    auto job = std::make_shared<Job>(count, task);
+    if (count > 1 && !workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.push_back(job);
+        }
+        queueCondition.notify_all();
+    }
+
+    // The caller always owns the last slot; workers use their own index.
+    job->run(workers.size());
+    job->wait();
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void ThreadPool::workerLoop(size_t slot) {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = jobs.front();
+        }
+
+        if (!job->run(slot)) {
+            // Every item is claimed; drop the job so idle workers go back to sleep.
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!jobs.empty() && jobs.front() == job) {
+                jobs.pop_front();
+            }
+        }
+    }
+}
+
+// Shared pool configuration. A count of 0 means one worker per hardware thread besides the caller.
+static std::shared_ptr<ThreadPool> sharedPool;
+static int sharedPoolThreads = 0;
+static std::mutex sharedPoolMutex;
+
+static size_t defaultWorkerCount() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+}
+
+std::shared_ptr<ThreadPool> getSharedThreadPool() {
+    std::lock_guard<std::mutex> lock(sharedPoolMutex);
+    if (!sharedPool) {
+        size_t workers = sharedPoolThreads > 0 ? static_cast<size_t>(sharedPoolThreads - 1) : defaultWorkerCount();
+        sharedPool = std::make_shared<ThreadPool>(workers);
+    }
+    return sharedPool;
+}
+
+FACELIB_API void setWorkerThreadCount(int threads) {
+    if (threads < 0) {
+        throw FaceLibException("Worker thread count must not be negative");
+    }
+
+    std::shared_ptr<ThreadPool> previous;
+    {
+        std::lock_guard<std::mutex> lock(sharedPoolMutex);
+        sharedPoolThreads = threads;
+        // The old pool is destroyed once the last batch still using it has finished.
+        previous = std::move(sharedPool);
+    }
+}
+
+FACELIB_API int getWorkerThreadCount() {
+    return static_cast<int>(getSharedThreadPool()->concurrency());
+}
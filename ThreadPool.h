@@ -0,0 +1,51 @@
+#ifndef FACELIB_THREADPOOL_H
+#define FACELIB_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Internal fixed-size worker pool used by the batch APIs - not part of the public header.
+class ThreadPool {
+public:
+    // Work item callback: index of the item and a slot in [0, concurrency()) that is unique
+    // among the threads running the same parallelFor() call, for per-thread scratch state.
+    using Task = std::function<void(size_t index, size_t slot)>;
+
+    explicit ThreadPool(size_t workerCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t workerCount() const { return workers.size(); }
+
+    // Number of threads that can run items of one parallelFor() call: the workers plus the caller.
+    size_t concurrency() const { return workers.size() + 1; }
+
+    // Runs task(i, slot) for every i in [0, count) and returns when all items are done.
+    // The calling thread works on the items too, so a nested call from inside a task cannot deadlock.
+    // The first exception thrown by a task is rethrown here after the remaining items have finished.
+    void parallelFor(size_t count, const Task& task);
+
+private:
+    struct Job;
+
+    void workerLoop(size_t slot);
+
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+};
+
+// Process-wide pool shared by the FaceLib batch functions, sized by setWorkerThreadCount().
+std::shared_ptr<ThreadPool> getSharedThreadPool();
+
+#endif //FACELIB_THREADPOOL_H
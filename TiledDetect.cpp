@@ -0,0 +1,169 @@
+#include "FaceLibInternal.h"
+#include "FaceLibLog.h"
+#include "ThreadPool.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <memory>
+
+// Detection over overlapping tiles of a large image. Every tile is scanned for faces up to twice the
+// overlap, without grouping; a tile keeps the raw hits whose centre lies in its own core, so each
+// window position on the frame is reported by exactly one tile. Larger faces come from one extra pass
+// over the frame downscaled until they fit the cascade window, which keeps only hits larger than the
+// tiles look for. All hits are then grouped together, approximately as if the frame had been scanned
+// in one piece.
+
+namespace {
+
+struct TileWorker {
+    std::unique_ptr<FaceDetector::Lease> classifiers;
+    cv::Mat gray;
+};
+
+// Replaces hits with the ungrouped detections of cascade index between minFace and maxFace (0 for no limit).
+void rawHits(const FaceDetector::Lease& classifiers, size_t index, const cv::Mat& gray, double scaleFactor,
+             int minFace, int maxFace, std::vector<cv::Rect>& hits) {
+    cv::Size minSize(minFace, minFace);
+    cv::Size maxSize(maxFace, maxFace);
+    if (const NativeCascade* native = classifiers.detector().nativeCascade(index)) {
+        hits.clear();
+        detectNativeMultiScale(*native, gray, scaleFactor, minSize, maxSize, classifiers.scratch(), hits);
+    } else {
+        classifiers[index].detectMultiScale(gray, hits, scaleFactor, 0, 0, minSize, maxSize);
+    }
+}
+
+// Whether a hit belongs to the tile pass: no larger than maxTileFace in either dimension. The coarse
+// pass keeps exactly the hits this rejects, so every size is reported by one pass.
+bool tileSized(const cv::Rect& face, int maxTileFace) {
+    return face.width <= maxTileFace && face.height <= maxTileFace;
+}
+
+// Scans one tile and appends the raw hits centred in core, in frame coordinates, per cascade.
+void scanTile(TileWorker& worker, const cv::Mat& frame, const cv::Rect& core, int overlap,
+              const TiledDetectOptions& options, int maxFace, std::vector<std::vector<cv::Rect>>& hits) {
+    cv::Rect extended(core.x - overlap, core.y - overlap, core.width + 2 * overlap, core.height + 2 * overlap);
+    extended &= cv::Rect(0, 0, frame.cols, frame.rows);
+    cv::Mat tile = frame(extended);
+    const cv::Mat& gray = toGray(tile, worker.gray);
+
+    std::vector<cv::Rect> tileHits;
+    for (size_t i = 0; i < worker.classifiers->size(); ++i) {
+        rawHits(*worker.classifiers, i, gray, options.scaleFactor, options.minSize, maxFace, tileHits);
+        for (const auto& hit : tileHits) {
+            cv::Rect face = hit + extended.tl();
+            if (tileSized(face, maxFace) && core.contains(cv::Point(face.x + face.width / 2, face.y + face.height / 2))) {
+                hits[i].push_back(face);
+            }
+        }
+    }
+}
+
+// Scans the frame downscaled so that the cascade window's longer side covers minFace pixels, and appends
+// the raw hits in frame coordinates that are too large for the tiles and no smaller than options.minSize.
+// The scan itself starts at the window size and the sizes are filtered afterwards, so that a window
+// rejected by the tiles for its longer side alone is not lost to a minimum on its shorter side.
+void scanCoarse(TileWorker& worker, const cv::Mat& frame, cv::Size window, const TiledDetectOptions& options,
+                int minFace, int maxTileFace, std::vector<std::vector<cv::Rect>>& hits) {
+    double factor = std::max(1.0, static_cast<double>(minFace) / std::max(window.width, window.height));
+    cv::Mat small;
+    cv::Size smallSize(cvRound(frame.cols / factor), cvRound(frame.rows / factor));
+    if (smallSize.width < window.width || smallSize.height < window.height) {
+        return;
+    }
+    if (factor > 1.0) {
+        cv::resize(frame, small, smallSize, 0, 0, cv::INTER_AREA);
+    } else {
+        small = frame;
+    }
+    const cv::Mat& gray = toGray(small, worker.gray);
+
+    std::vector<cv::Rect> smallHits;
+    for (size_t i = 0; i < worker.classifiers->size(); ++i) {
+        rawHits(*worker.classifiers, i, gray, options.scaleFactor, 0, 0, smallHits);
+        for (const auto& hit : smallHits) {
+            cv::Rect face(cvRound(hit.x * factor), cvRound(hit.y * factor), cvRound(hit.width * factor), cvRound(hit.height * factor));
+            // Rounding back to frame pixels must not hand the tiles' sizes to this pass too.
+            if (!tileSized(face, maxTileFace) && face.width >= options.minSize && face.height >= options.minSize) {
+                hits[i].push_back(face);
+            }
+        }
+    }
+}
+
+} // namespace
+
+FACELIB_API std::vector<FaceRect> detectFacesTiled(const ImageData* image, const TiledDetectOptions& options) {
+    std::shared_ptr<const FaceDetector> detector = getDefaultDetector();
+    return detectFacesTiled(detector.get(), image, options);
+}
+
+FACELIB_API std::vector<FaceRect> detectFacesTiled(const FaceDetector* detector, const ImageData* image, const TiledDetectOptions& options) {
+    if (!image || image->mat.empty()) {
+        throw ImageProcessingException("Cannot detect faces in empty or null image");
+    }
+    if (!detector) {
+        throw FaceDetectionException("Face detector is null. Call createFaceDetector() first.");
+    }
+    // Tiles find faces up to 2 * overlap, and a limit of 0 would mean no limit at all.
+    if (options.tileSize <= 0 || options.overlap <= 0) {
+        throw FaceDetectionException("Tile size and overlap must be positive");
+    }
+    checkScaleFactor(options.scaleFactor);
+
+    const cv::Mat& frame = image->mat;
+    int tileSize = options.tileSize;
+    int overlap = options.overlap;
+    if ((frame.cols <= tileSize + overlap && frame.rows <= tileSize + overlap) || detector->waldBoostModel()) {
+        return detectFaces(detector, image, options.scaleFactor, options.minNeighbors, options.minSize);
+    }
+
+    try {
+        int tileColumns = (frame.cols + tileSize - 1) / tileSize;
+        int tileRows = (frame.rows + tileSize - 1) / tileSize;
+        size_t tileCount = static_cast<size_t>(tileColumns) * tileRows;
+        // Tiles take faces up to maxTileFace and the coarse pass everything larger, so no size is scanned twice.
+        int maxTileFace = 2 * overlap;
+        int coarseMinFace = std::max(maxTileFace + 1, options.minSize);
+        bool scanTiles = maxTileFace >= options.minSize;
+
+        // Raw hits per work item and cascade; the coarse pass is the last item.
+        std::vector<std::vector<std::vector<cv::Rect>>> itemHits(tileCount + 1,
+                                                                 std::vector<std::vector<cv::Rect>>(detector->cascadeCount()));
+
+        std::shared_ptr<ThreadPool> pool = getSharedThreadPool();
+        std::vector<TileWorker> workers(pool->concurrency());
+        pool->parallelFor(tileCount + 1, [&](size_t index, size_t slot) {
+            TileWorker& worker = workers[slot];
+            if (!worker.classifiers) {
+                worker.classifiers = std::make_unique<FaceDetector::Lease>(*detector);
+            }
+            if (index == tileCount) {
+                scanCoarse(worker, frame, detector->windowSize(), options, coarseMinFace, maxTileFace, itemHits[index]);
+            } else if (scanTiles) {
+                int column = static_cast<int>(index % tileColumns);
+                int row = static_cast<int>(index / tileColumns);
+                cv::Rect core = cv::Rect(column * tileSize, row * tileSize, tileSize, tileSize) & cv::Rect(0, 0, frame.cols, frame.rows);
+                scanTile(worker, frame, core, overlap, options, maxTileFace, itemHits[index]);
+            }
+        });
+
+        std::vector<std::vector<cv::Rect>> hits(detector->cascadeCount());
+        for (auto& item : itemHits) {
+            for (size_t i = 0; i < hits.size(); ++i) {
+                hits[i].insert(hits[i].end(), item[i].begin(), item[i].end());
+            }
+        }
+        std::vector<cv::Rect> faces = mergeCascadeHits(*detector, hits, options.minNeighbors);
+
+        std::vector<FaceRect> result;
+        result.reserve(faces.size());
+        for (const auto& face : faces) {
+            result.emplace_back(face.x, face.y, face.width, face.height);
+        }
+        FACELIB_LOG_INFO("Detected " << result.size() << " face(s) over " << tileCount << " tile(s)");
+        return result;
+
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error during tiled face detection: " + std::string(e.what()));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "FaceLibInternal.h"
+#include <opencv2/imgproc.hpp>
+#ifdef FACELIB_WITH_XOBJDETECT
+#include <opencv2/xobjdetect.hpp>
+#endif
+
+// Files written by cv::xobjdetect::WBDetector::write() hold a "waldboost_params" map.
+bool isWaldBoostModel(const cv::FileNode& node) {
+    return node.isMap() && !node["waldboost_params"].empty();
+}
+
+// WBDetector's fixed window size.
+cv::Size waldBoostWindowSize() {
+    return cv::Size(24, 24);
+}
+
+#ifdef FACELIB_WITH_XOBJDETECT
+
+class WaldBoostModel {
+public:
+    // WBDetector::detect() builds its feature evaluator per call and only reads the model, so one
+    // instance serves every thread.
+    cv::Ptr<cv::xobjdetect::WBDetector> detector;
+};
+
+std::shared_ptr<const WaldBoostModel> loadWaldBoostModel(const cv::FileNode& node, const std::string& path) {
+    if (!isWaldBoostModel(node)) {
+        throw FaceDetectionException("Not a WaldBoost model: " + path);
+    }
+    auto model = std::make_shared<WaldBoostModel>();
+    try {
+        model->detector = cv::xobjdetect::WBDetector::create();
+        model->detector->read(node);
+    } catch (const cv::Exception& e) {
+        throw FaceDetectionException("OpenCV error loading WaldBoost model " + path + ": " + e.what());
+    }
+    return model;
+}
+
+// WBDetector scans the image at scales from 0.2 to 1.1, which covers faces of roughly 22 to 120 pixels.
+// Larger faces are found by running it again on the image shrunk by 5, 25, ... Faces found on two
+// levels are merged by confidence.
+std::vector<cv::Rect> detectWaldBoost(const WaldBoostModel& model, const cv::Mat& gray, int minSize) {
+    const int largestFace = 120;
+    cv::Size window = waldBoostWindowSize();
+
+    std::vector<cv::Rect> faces;
+    std::vector<double> scores;
+    cv::Mat level = gray;
+    for (int factor = 1; ; factor *= 5) {
+        if (largestFace * factor >= minSize) {
+            std::vector<cv::Rect> boxes;
+            std::vector<double> confidences;
+            model.detector->detect(level, boxes, confidences);
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                cv::Rect face(boxes[i].x * factor, boxes[i].y * factor, boxes[i].width * factor, boxes[i].height * factor);
+                if (face.width >= minSize && face.height >= minSize) {
+                    faces.push_back(face & cv::Rect(0, 0, gray.cols, gray.rows));
+                    scores.push_back(confidences[i]);
+                }
+            }
+        }
+
+        cv::Size next(gray.cols / (factor * 5), gray.rows / (factor * 5));
+        if (next.width <= window.width || next.height <= window.height) {
+            break;
+        }
+        cv::resize(gray, level, next, 0, 0, cv::INTER_AREA);
+    }
+    return suppressOverlaps(faces, scores, 0.3);
+}
+
+#else
+
+class WaldBoostModel {};
+
+std::shared_ptr<const WaldBoostModel> loadWaldBoostModel(const cv::FileNode&, const std::string& path) {
+    throw FaceDetectionException("Cannot load WaldBoost model " + path + ": FaceLib was built without FACELIB_WITH_XOBJDETECT");
+}
+
+std::vector<cv::Rect> detectWaldBoost(const WaldBoostModel&, const cv::Mat&, int) {
+    throw FaceDetectionException("FaceLib was built without FACELIB_WITH_XOBJDETECT");
+}
+
+#endif
\ No newline at end of file
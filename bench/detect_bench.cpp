@@ -0,0 +1,90 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/objdetect.hpp>
+#include "FaceLib.h"
+
+// Times FaceLib's cascade engine at every SIMD level the CPU supports against cv::CascadeClassifier
+// on the same image and parameters, and checks that they find the same faces.
+// Usage: detect_bench <haarcascade.xml> <image> [iterations]
+
+using Clock = std::chrono::steady_clock;
+
+static const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::SSE42: return "sse4.2";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+static bool sameFaces(const std::vector<FaceRect>& faces, const std::vector<cv::Rect>& reference) {
+    if (faces.size() != reference.size()) {
+        return false;
+    }
+    for (const auto& face : faces) {
+        bool found = false;
+        for (const auto& rect : reference) {
+            found = found || (face.x == rect.x && face.y == rect.y && face.width == rect.width && face.height == rect.height);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <haarcascade.xml> <image> [iterations]\n";
+        return EXIT_FAILURE;
+    }
+    const std::string cascadePath = argv[1];
+    const std::string imagePath = argv[2];
+    const int iterations = argc > 3 ? std::stoi(argv[3]) : 20;
+
+    try {
+        setLogLevel(LogLevel::Warning);
+        FaceDetectorHandle detector = createFaceDetector(cascadePath);
+        Image image = loadImageGrayFromBinary(readImageFile(imagePath));
+
+        cv::CascadeClassifier reference;
+        if (!reference.load(cascadePath)) {
+            std::cerr << "OpenCV cannot load " << cascadePath << '\n';
+            return EXIT_FAILURE;
+        }
+        cv::Mat gray = cv::imread(imagePath, cv::IMREAD_GRAYSCALE);
+        std::vector<cv::Rect> referenceFaces;
+
+        auto start = Clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            reference.detectMultiScale(gray, referenceFaces, 1.1, 3, 0, cv::Size(30, 30));
+        }
+        double referenceMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+        std::cout << gray.cols << "x" << gray.rows << ", " << iterations << " iteration(s)\n";
+        std::cout << "opencv    " << referenceMs << " ms/frame, " << referenceFaces.size() << " face(s)\n";
+
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (!isSimdLevelSupported(level)) {
+                continue;
+            }
+            setSimdLevel(level);
+            std::vector<FaceRect> faces = detectFaces(detector.get(), image.get());
+            start = Clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                faces = detectFaces(detector.get(), image.get());
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+            std::cout << simdLevelName(level) << "    " << ms << " ms/frame, " << faces.size() << " face(s), "
+                      << referenceMs / ms << "x, " << (sameFaces(faces, referenceFaces) ? "same faces" : "FACES DIFFER") << '\n';
+        }
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FaceLib.h"
+
+// Times every encode profile for JPEG, PNG and WebP on the colour and grayscale versions of an image,
+// reporting raw pixel throughput against output size, then the batch encoder on the worker pool.
+// Usage: encode_bench <image> [iterations]
+
+using Clock = std::chrono::steady_clock;
+
+static const char* formatName(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::JPEG: return "jpeg";
+        case ImageFormat::PNG: return "png";
+        case ImageFormat::WebP: return "webp";
+    }
+    return "?";
+}
+
+static const char* profileName(EncodeProfile profile) {
+    switch (profile) {
+        case EncodeProfile::Default: return "default";
+        case EncodeProfile::Archive: return "archive";
+        case EncodeProfile::Thumbnail: return "thumbnail";
+        case EncodeProfile::Fastest: return "fastest";
+    }
+    return "?";
+}
+
+static double pixelBytes(const ImageData* image) {
+    ImageView view = getImageView(image);
+    return static_cast<double>(view.width) * view.height * (view.format == PixelFormat::Gray8 ? 1 : view.format == PixelFormat::BGRA8 ? 4 : 3);
+}
+
+static void benchImage(const char* label, const ImageData* image, int iterations) {
+    const double bytes = pixelBytes(image);
+    std::vector<unsigned char> output;
+    for (ImageFormat format : {ImageFormat::JPEG, ImageFormat::PNG, ImageFormat::WebP}) {
+        for (EncodeProfile profile : {EncodeProfile::Default, EncodeProfile::Archive, EncodeProfile::Thumbnail, EncodeProfile::Fastest}) {
+            ImageEncoderHandle encoder = createImageEncoder(format, profile);
+            encodeImage(encoder.get(), image, output);
+            auto start = Clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                encodeImage(encoder.get(), image, output);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count() / iterations;
+            std::cout << std::left << std::setw(7) << label << std::setw(6) << formatName(format) << std::setw(11) << profileName(profile)
+                      << std::right << std::setw(9) << std::fixed << std::setprecision(2) << seconds * 1000 << " ms "
+                      << std::setw(9) << bytes / seconds / (1024 * 1024) << " MB/s "
+                      << std::setw(10) << output.size() << " bytes" << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <image> [iterations]\n";
+        return EXIT_FAILURE;
+    }
+    const std::string imagePath = argv[1];
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 20;
+
+    try {
+        setLogLevel(LogLevel::Warning);
+        Image colour = loadImageFromBinary(readImageFile(imagePath));
+        Image gray = convertToGrayscale(colour.get());
+        int width = 0;
+        int height = 0;
+        getImageDimensions(colour.get(), width, height);
+        std::cout << width << "x" << height << ", " << iterations << " iteration(s)\n";
+
+        benchImage("colour", colour.get(), iterations);
+        benchImage("gray", gray.get(), iterations);
+
+        // Throughput of the batch encoder, as the pipeline would encode a batch of grayscale crops.
+        std::vector<const ImageData*> batch(64, gray.get());
+        std::vector<std::vector<unsigned char>> outputs;
+        for (EncodeProfile profile : {EncodeProfile::Default, EncodeProfile::Thumbnail, EncodeProfile::Fastest}) {
+            ImageEncoderHandle encoder = createImageEncoder(ImageFormat::JPEG, profile);
+            encodeImagesBatch(encoder.get(), batch, outputs);
+            auto start = Clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                encodeImagesBatch(encoder.get(), batch, outputs);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count() / iterations;
+            std::cout << "batch jpeg " << std::left << std::setw(11) << profileName(profile) << std::right
+                      << std::setw(9) << batch.size() / seconds << " images/s\n";
+        }
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
@@ -15,38 +15,33 @@ std::cerr << "Error: " << label << " image is empty or could not be read.\n";
 return false;
 }
 
-ImageData* originalImage = loadImageFromBinary(imageData);
+Image originalImage = loadImageFromBinary(imageData);
 int width, height;
-getImageDimensions(originalImage, width, height);
+getImageDimensions(originalImage.get(), width, height);
 std::cout << label << " dimensions: " << width << "x" << height << '\n';
 
-displayImage(originalImage, label + " - Original", 3000);
+displayImage(originalImage.get(), label + " - Original", 3000);
 
-std::vector<FaceRect> faces = detectFaces(originalImage, 1.1, 3, 50);
+std::vector<FaceRect> faces = detectFaces(originalImage.get(), 1.1, 3, 50);
 std::cout << "Detected " << faces.size() << " face(s) in " << label << '\n';
 
 if (!faces.empty()) {
-ImageData* imageWithFaces = drawFaceRectangles(originalImage, faces);
-displayImage(imageWithFaces, label + " - Face Detection", 3000);
+Image imageWithFaces = drawFaceRectangles(originalImage.get(), faces);
+displayImage(imageWithFaces.get(), label + " - Face Detection", 3000);
 
-ImageData* croppedFace = cropToLargestFace(originalImage, 0.0);
-ImageData* grayscaleFace = convertToGrayscale(croppedFace);
-getImageDimensions(grayscaleFace, width, height);
+Image croppedFace = cropToLargestFace(originalImage.get(), faces, 0.0);
+Image grayscaleFace = convertToGrayscale(croppedFace.get());
+getImageDimensions(grayscaleFace.get(), width, height);
 std::cout << "Cropped Grayscale " << label << " dimensions: " << width << "x" << height << '\n';
 
-displayImage(grayscaleFace, label + " - Grayscale Face", 0);
+displayImage(grayscaleFace.get(), label + " - Grayscale Face", 0);
 
-std::vector<unsigned char> croppedFaceData = saveImageToBinary(grayscaleFace, ".jpg");
+std::vector<unsigned char> croppedFaceData = saveImageToBinary(grayscaleFace.get(), ".jpg");
 writeBinaryToFile(croppedFaceData, outputPath);
-
-deleteImage(imageWithFaces);
-deleteImage(croppedFace);
-deleteImage(grayscaleFace);
 } else {
 std::cout << "No faces detected in " << label << ".\n";
 }
 
-deleteImage(originalImage);
 return true;
 } catch (const std::exception& e) {
 std::cerr << "Error processing " << label << ": " << e.what() << '\n';
@@ -56,6 +51,8 @@ return false;
 
 int main() {
 try {
+setLogLevel(LogLevel::Info);
+
 const std::string cascadePath = "../Cascade/haarcascade_frontalface_alt.xml";
 std::cout << "Loading Haar cascade...\n";
 if (!loadHaarCascade(cascadePath)) {
@@ -0,0 +1,143 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "FaceLib.h"
+#include "NativeCascade.h"
+
+// Loads damaged and hostile binary cascades and checks that each one is rejected with
+// FaceDetectionException before anything is evaluated.
+// Usage: native_cascade_test <haarcascade.xml> <scratch directory>
+
+static int failures = 0;
+
+static std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+static NativeCascadeHeader headerOf(const std::vector<unsigned char>& bytes) {
+    NativeCascadeHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    return header;
+}
+
+// Overwrites element index of a section with value.
+template <typename T>
+static void patch(std::vector<unsigned char>& bytes, int section, uint64_t index, T value) {
+    std::memcpy(bytes.data() + headerOf(bytes).sectionOffset[section] + index * sizeof(T), &value, sizeof(T));
+}
+
+static void expectLoad(const std::string& name, const std::string& path, bool valid) {
+    bool loaded = false;
+    try {
+        FaceDetectorHandle detector = createFaceDetector(path);
+        loaded = true;
+    } catch (const FaceDetectionException&) {
+    } catch (const std::exception& e) {
+        std::cerr << "FAIL " << name << ": unexpected exception: " << e.what() << '\n';
+        ++failures;
+        return;
+    }
+    if (loaded != valid) {
+        std::cerr << "FAIL " << name << ": " << (valid ? "rejected" : "accepted") << '\n';
+        ++failures;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <haarcascade.xml> <scratch directory>\n";
+        return EXIT_FAILURE;
+    }
+    setLogLevel(LogLevel::Error);
+    const std::string path = std::string(argv[2]) + "/native_cascade_test.flc";
+    compileCascade(argv[1], path);
+    const std::vector<unsigned char> original = readFile(path);
+    const uint32_t features = headerOf(original).featureCount;
+
+    auto check = [&](const std::string& name, bool valid, const std::function<void(std::vector<unsigned char>&)>& damage) {
+        std::vector<unsigned char> bytes = original;
+        damage(bytes);
+        writeFile(path, bytes);
+        expectLoad(name, path, valid);
+    };
+
+    check("original", true, [](std::vector<unsigned char>&) {});
+
+    for (size_t length : {size_t(4), size_t(8), sizeof(NativeCascadeHeader) - 1, sizeof(NativeCascadeHeader),
+                          original.size() / 2, original.size() - 1}) {
+        check("truncated to " + std::to_string(length), false, [length](std::vector<unsigned char>& bytes) { bytes.resize(length); });
+    }
+
+    check("bad magic", false, [](std::vector<unsigned char>& bytes) { bytes[0] = 'X'; });
+    check("bad version", false, [](std::vector<unsigned char>& bytes) { bytes[8] ^= 0xff; });
+    check("section past the end", false, [](std::vector<unsigned char>& bytes) {
+        NativeCascadeHeader header = headerOf(bytes);
+        header.sectionOffset[NativeCascadeHeader::RectX] = bytes.size() + 64;
+        std::memcpy(bytes.data(), &header, sizeof(header));
+    });
+    check("feature count too large", false, [](std::vector<unsigned char>& bytes) {
+        NativeCascadeHeader header = headerOf(bytes);
+        header.featureCount *= 4;
+        std::memcpy(bytes.data(), &header, sizeof(header));
+    });
+    check("child INT32_MIN", false, [](std::vector<unsigned char>& bytes) {
+        patch<int32_t>(bytes, NativeCascadeHeader::NodeLeft, 0, INT32_MIN);
+    });
+    check("child past its tree", false, [](std::vector<unsigned char>& bytes) {
+        patch<int32_t>(bytes, NativeCascadeHeader::NodeLeft, 0, 1000);
+    });
+    check("missing feature", false, [features](std::vector<unsigned char>& bytes) {
+        patch<uint32_t>(bytes, NativeCascadeHeader::NodeFeature, 0, features);
+    });
+
+    // The first two rectangles are always read, whatever their weight.
+    for (uint64_t k : {0ull, 1ull}) {
+        std::string rect = "rectangle " + std::to_string(k);
+        check(rect + " with weight 0 outside the window", false, [k, features](std::vector<unsigned char>& bytes) {
+            patch<float>(bytes, NativeCascadeHeader::RectWeight, k * features, 0.0f);
+            patch<int32_t>(bytes, NativeCascadeHeader::RectX, k * features, 1000000);
+        });
+        check(rect + " negative", false, [k, features](std::vector<unsigned char>& bytes) {
+            patch<int32_t>(bytes, NativeCascadeHeader::RectY, k * features, -1);
+        });
+        check(rect + " x + width overflowing", false, [k, features](std::vector<unsigned char>& bytes) {
+            patch<int32_t>(bytes, NativeCascadeHeader::RectX, k * features, INT32_MAX);
+            patch<int32_t>(bytes, NativeCascadeHeader::RectW, k * features, 16);
+        });
+        check(rect + " y + height overflowing", false, [k, features](std::vector<unsigned char>& bytes) {
+            patch<int32_t>(bytes, NativeCascadeHeader::RectY, k * features, 16);
+            patch<int32_t>(bytes, NativeCascadeHeader::RectH, k * features, INT32_MAX);
+        });
+    }
+
+    // A third rectangle with weight 0 is never read, so its coordinates do not matter.
+    check("unused third rectangle", true, [features](std::vector<unsigned char>& bytes) {
+        patch<float>(bytes, NativeCascadeHeader::RectWeight, 2ull * features, 0.0f);
+        patch<int32_t>(bytes, NativeCascadeHeader::RectX, 2ull * features, INT32_MAX);
+    });
+    check("used third rectangle outside the window", false, [features](std::vector<unsigned char>& bytes) {
+        patch<float>(bytes, NativeCascadeHeader::RectWeight, 2ull * features, 1.0f);
+        patch<int32_t>(bytes, NativeCascadeHeader::RectX, 2ull * features, 1000000);
+    });
+
+    std::remove(path.c_str());
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+#include <iostream>
+#include "FaceLib.h"
+
+// Compiles a Haar cascade XML file into FaceLib's binary cascade format.
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <cascade.xml> <output.flc>\n";
+        return EXIT_FAILURE;
+    }
+
+    try {
+        compileCascade(argv[1], argv[2]);
+        std::cout << "Compiled " << argv[1] << " to " << argv[2] << '\n';
+        return EXIT_SUCCESS;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}